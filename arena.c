@@ -0,0 +1,99 @@
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "prof.h"
+
+#define ARENA_DEFAULT_CHUNK (64 * 1024)
+#define ARENA_MAX_CHUNK     (8 * 1024 * 1024)
+#define ARENA_ALIGN         (sizeof(max_align_t))
+
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t size;
+    size_t used;
+    max_align_t data[];
+} ArenaChunk;
+
+//rounds size up to the arena alignment
+static size_t alignUp(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+Arena* createArena(size_t firstChunkSize) {
+    Arena* arena = (Arena*)calloc(1, sizeof(Arena));
+    if (arena == NULL)
+        exit(1);
+
+    arena->nextChunkSize = firstChunkSize ? firstChunkSize : ARENA_DEFAULT_CHUNK;
+    return arena;
+}
+
+//adds a chunk big enough for size bytes, chunk sizes double up to a cap
+static ArenaChunk* addChunk(Arena* arena, size_t size) {
+    size_t chunkSize = arena->nextChunkSize;
+    if (chunkSize < size)
+        chunkSize = size;
+
+    ArenaChunk* chunk = (ArenaChunk*)malloc(sizeof(ArenaChunk) + chunkSize);
+    if (chunk == NULL)
+        exit(1);
+
+    chunk->size = chunkSize;
+    chunk->used = 0;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+
+    arena->chunkCount++;
+    arena->bytesReserved += chunkSize;
+    if (arena->nextChunkSize < ARENA_MAX_CHUNK)
+        arena->nextChunkSize *= 2;
+
+    return chunk;
+}
+
+//returns size bytes of aligned memory that lives until arenaFree
+void* arenaAlloc(Arena* arena, size_t size) {
+    size = alignUp(size ? size : 1);
+
+    ArenaChunk* chunk = arena->chunks;
+    if (chunk == NULL || chunk->size - chunk->used < size)
+        chunk = addChunk(arena, size);
+
+    void* ptr = (unsigned char*)chunk->data + chunk->used;
+    chunk->used += size;
+
+    arena->allocCount++;
+    arena->bytesUsed += size;
+    return ptr;
+}
+
+//copies a string into the arena
+char* arenaStrdup(Arena* arena, const char* str) {
+    size_t len = strlen(str) + 1;
+    char* copy = (char*)arenaAlloc(arena, len);
+    memcpy(copy, str, len);
+    return copy;
+}
+
+//prints how many allocations the arena absorbed and how much memory it held
+void arenaReport(const Arena* arena, FILE* out) {
+    fprintf(out, "arena: %ld allocations served by %ld chunk mallocs, "
+        "%zu bytes used, %zu bytes peak\n",
+        arena->allocCount, arena->chunkCount,
+        arena->bytesUsed, arena->bytesReserved);
+}
+
+//releases every chunk and the arena, O(number of chunks)
+void arenaFree(Arena* arena) {
+    if (arena == NULL)
+        return;
+
+    ArenaChunk* chunk = arena->chunks;
+    while (chunk != NULL) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    free(arena);
+}
@@ -0,0 +1,28 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+struct ArenaChunk;
+
+/*
+ * Bump allocator for objects that all die together.
+ * Nothing is freed individually, arenaFree releases every chunk at once.
+ */
+typedef struct {
+    struct ArenaChunk* chunks;
+    size_t nextChunkSize;
+    long allocCount;       // objects carved out of the arena
+    long chunkCount;       // mallocs actually performed
+    size_t bytesUsed;      // bytes handed out to callers
+    size_t bytesReserved;  // bytes held in chunks, this is also the peak
+} Arena;
+
+Arena* createArena(size_t firstChunkSize);
+void* arenaAlloc(Arena* arena, size_t size);
+char* arenaStrdup(Arena* arena, const char* str);
+void arenaReport(const Arena* arena, FILE* out);
+void arenaFree(Arena* arena);
+
+#endif
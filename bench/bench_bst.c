@@ -0,0 +1,111 @@
+/*
+ * BST benchmark: inserts n keys in sorted, reverse sorted and random order
+ * into the plain tree and the balanced (AVL) tree, then looks every key up.
+ * Build from the repository root:
+ *   gcc -O2 -I. bench/bench_bst.c bst.c btree.c arena.c -o bench_bst
+ * Usage: bench_bst [n]  (default 20000, the plain tree is quadratic on sorted input)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bst.h"
+
+typedef enum { SORTED, REVERSED, RANDOM } KeyOrder;
+
+static const char* orderNames[] = { "sorted", "reversed", "random" };
+
+static double nowNs(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int compareInts(void* a, void* b) {
+    int x = *(int*)a;
+    int y = *(int*)b;
+    return (x > y) - (x < y);
+}
+
+//fills keys with 0..n-1 in the requested order
+static void makeKeys(int* keys, int n, KeyOrder order) {
+    for (int i = 0; i < n; i++)
+        keys[i] = (order == REVERSED) ? n - 1 - i : i;
+
+    if (order != RANDOM)
+        return;
+
+    unsigned int seed = 2463534242u;
+    for (int i = n - 1; i > 0; i--) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        int j = (int)(seed % (unsigned int)(i + 1));
+        int tmp = keys[i];
+        keys[i] = keys[j];
+        keys[j] = tmp;
+    }
+}
+
+//level by level height, works for plain trees that do not track heights
+static int treeHeight(BSTNode* root) {
+    if (root == NULL)
+        return 0;
+
+    int height = 0;
+    int size = 1;
+    BSTNode** level = malloc(sizeof(BSTNode*));
+    level[0] = root;
+    while (size > 0) {
+        BSTNode** next = malloc(2 * size * sizeof(BSTNode*));
+        int nextSize = 0;
+        for (int i = 0; i < size; i++) {
+            if (level[i]->left) next[nextSize++] = level[i]->left;
+            if (level[i]->right) next[nextSize++] = level[i]->right;
+        }
+        free(level);
+        level = next;
+        size = nextSize;
+        height++;
+    }
+    free(level);
+    return height;
+}
+
+static void benchTree(int balanced, int* keys, int n, KeyOrder order) {
+    BST* tree = balanced ? createBalancedBST(compareInts, NULL, NULL)
+                         : createBST(compareInts, NULL, NULL);
+
+    double start = nowNs();
+    for (int i = 0; i < n; i++)
+        bstAdd(tree, &keys[i]);
+    double insertNs = (nowNs() - start) / n;
+
+    int found = 0;
+    start = nowNs();
+    for (int i = 0; i < n; i++)
+        if (bstLookup(tree, &keys[i]))
+            found++;
+    double findNs = (nowNs() - start) / n;
+
+    printf("%-8s %-9s n=%-8d insert %9.1f ns/op  find %9.1f ns/op  height %d\n",
+        balanced ? "avl" : "plain", orderNames[order], n,
+        insertNs, findNs, treeHeight(tree->root));
+
+    bstDestroy(tree);
+}
+
+int main(int argc, char* argv[]) {
+    int n = argc > 1 ? atoi(argv[1]) : 20000;
+    int* keys = malloc(n * sizeof(int));
+    if (keys == NULL)
+        return 1;
+
+    for (int order = SORTED; order <= RANDOM; order++) {
+        makeKeys(keys, n, (KeyOrder)order);
+        benchTree(0, keys, n, (KeyOrder)order);
+        benchTree(1, keys, n, (KeyOrder)order);
+    }
+
+    free(keys);
+    return 0;
+}
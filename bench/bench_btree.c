@@ -0,0 +1,176 @@
+/*
+ * B-tree benchmark: bot-sized inventories in the pointer AVL tree and in the
+ * B-tree backend, both through the BST handle with compareItems.
+ *   pickup    PICKUP's duplicate check and insert: bstLookup, then bstAdd
+ *   find      n lookups, half of them misses
+ *   list      one inorder walk, as the bag listing does
+ *   destroy   bstDestroy
+ * Items come from a pool of interned names with random values, about a
+ * third of the pickups are duplicates. Both trees must end up with the
+ * same elements in the same order.
+ * Build from the repository root:
+ *   gcc -O2 -I. bench/bench_btree.c game.c checkpoint.c bst.c btree.c utils.c roomindex.c roomstore.c arena.c render.c intern.c -o bench_btree
+ * Usage: bench_btree [maxN] [--seed n]  (default 1000000, seed 42)
+ */
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "btree.h"
+#include "game.h"
+
+#define NAME_POOL 512
+
+//xorshift32, the same seed always gives the same workload
+static unsigned int nextRandom(unsigned int* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void makeItems(Item* items, int n, const char** pool, unsigned int* seed) {
+    for (int i = 0; i < n; i++) {
+        items[i].name = (char*)pool[nextRandom(seed) % NAME_POOL];
+        items[i].sortKey = nameSortKey(items[i].name);
+        items[i].type = (ItemType)(nextRandom(seed) & 1);
+        items[i].value = (int)(nextRandom(seed) % (unsigned int)(n / 1024 + 1));
+    }
+}
+
+typedef struct {
+    const Item** seen;
+    int count;
+    long long checksum;
+} Listing;
+
+static void listItem(void* data, void* ctx) {
+    Listing* l = (Listing*)ctx;
+    if (l->seen != NULL)
+        l->seen[l->count] = (const Item*)data;
+    l->count++;
+    l->checksum += ((const Item*)data)->value;
+}
+
+static void report(const char* bench, int n, long long ops, long long avlNs, long long btreeNs) {
+    printf("%-8s %9d %10.1f ns/op avl %10.1f ns/op btree  x%.2f\n", bench, n,
+        (double)avlNs / ops, (double)btreeNs / ops,
+        btreeNs > 0 ? (double)avlNs / btreeNs : 0.0);
+}
+
+//times every step on one tree, returns the number of items kept
+static int runTree(BST* tree, const Item* items, const Item* probes, int n,
+    long long* ns, int* found, Listing* listing) {
+    int kept = 0;
+    long long start = nowNanos();
+    for (int i = 0; i < n; i++) {
+        if (bstLookup(tree, (void*)&items[i]) == NULL) {
+            bstAdd(tree, (void*)&items[i]);
+            kept++;
+        }
+    }
+    ns[0] = nowNanos() - start;
+
+    *found = 0;
+    start = nowNanos();
+    for (int i = 0; i < n; i++)
+        *found += bstLookup(tree, (void*)&probes[i]) != NULL;
+    ns[1] = nowNanos() - start;
+
+    start = nowNanos();
+    bstForEach(tree, BST_INORDER, listItem, listing);
+    ns[2] = nowNanos() - start;
+    return kept;
+}
+
+static int benchSize(int n, const char** pool, unsigned int seed, const Item** seen) {
+    Item* items = (Item*)malloc(2 * (size_t)n * sizeof(Item));
+    if (items == NULL)
+        exit(1);
+    Item* probes = items + n;
+    makeItems(items, n, pool, &seed);
+    //every other probe has a value no item has, so it misses
+    for (int i = 0; i < n; i++) {
+        probes[i] = items[nextRandom(&seed) % (unsigned int)n];
+        if (i & 1)
+            probes[i].value = -1 - probes[i].value;
+    }
+
+    long long avlNs[4], btreeNs[4];
+    int avlFound, btreeFound;
+    Listing avlList = { seen, 0, 0 };
+    Listing btreeList = { NULL, 0, 0 };
+
+    BST* avl = createBalancedBST(compareItems, NULL, NULL);
+    int avlKept = runTree(avl, items, probes, n, avlNs, &avlFound, &avlList);
+    long long start = nowNanos();
+    bstDestroy(avl);
+    avlNs[3] = nowNanos() - start;
+
+    BST* btree = createBTreeBST(sizeof(Item), compareItems, NULL, NULL);
+    int btreeKept = runTree(btree, items, probes, n, btreeNs, &btreeFound, &btreeList);
+
+    //same elements in the same order: compare the B-tree against the AVL listing
+    int ok = avlKept == btreeKept && avlFound == btreeFound && avlList.count == btreeList.count
+        && avlList.checksum == btreeList.checksum;
+    for (int i = 0; i < avlList.count && ok; i++)
+        ok = bstLookup(btree, (void*)seen[i]) != NULL
+            && (i == 0 || compareItems((void*)seen[i - 1], (void*)seen[i]) < 0);
+
+    start = nowNanos();
+    bstDestroy(btree);
+    btreeNs[3] = nowNanos() - start;
+
+    report("pickup", n, n, avlNs[0], btreeNs[0]);
+    report("find", n, n, avlNs[1], btreeNs[1]);
+    report("list", avlKept, avlKept > 0 ? avlKept : 1, avlNs[2], btreeNs[2]);
+    report("destroy", avlKept, avlKept > 0 ? avlKept : 1, avlNs[3], btreeNs[3]);
+
+    free(items);
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    int maxN = 1000000;
+    unsigned int seed = 42;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        else
+            maxN = atoi(argv[i]);
+    }
+    //xorshift never leaves 0
+    if (seed == 0)
+        seed = 1;
+    if (maxN < 1000)
+        maxN = 1000;
+
+    NameTable names = {0};
+    const char* pool[NAME_POOL];
+    char buffer[32];
+    for (int i = 0; i < NAME_POOL; i++) {
+        sprintf(buffer, "Item%d", i);
+        pool[i] = internName(&names, buffer, NULL);
+    }
+
+    const Item** seen = (const Item**)malloc((size_t)maxN * sizeof(Item*));
+    if (seen == NULL)
+        return 1;
+
+    BTree* shape = createBTree(sizeof(Item), compareItems);
+    printf("B-tree nodes hold %d items\n", shape->maxKeys);
+    btreeFree(shape);
+    int ok = 1;
+    for (int n = 1000; n <= maxN; n *= 10)
+        ok &= benchSize(n, pool, seed, seen);
+
+    free(seen);
+    nameTableFree(&names);
+    if (!ok) {
+        fprintf(stderr, "B-tree and AVL tree disagree\n");
+        return 1;
+    }
+    return 0;
+}
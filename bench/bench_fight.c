@@ -0,0 +1,169 @@
+/*
+ * Fight resolution check and benchmark: resolveFight against the round loop
+ * the FIGHT command used to run, over every small (hp, attack) pair on both
+ * sides, zero and negative values included. Every field of the result must
+ * match the loop; a fight the loop would never finish must come back endless.
+ * The batch evaluator of the balance sweeps (the vector path this machine
+ * picks) must give resolveFight's outcome and hp left on the same values.
+ * Then both are timed on long fights, where the loop pays for every round.
+ * Build from the repository root:
+ *   gcc -O2 -I. bench/bench_fight.c combat.c game.c checkpoint.c bst.c btree.c utils.c roomindex.c roomstore.c arena.c render.c intern.c -lm -o bench_fight
+ * Usage: bench_fight [range]  (default 12, values checked in [-range/2, range])
+ */
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "combat.h"
+
+#define ROUND_LIMIT 100000
+#define TIMED_FIGHTS 2000
+
+//monotonic enough wall clock in nanoseconds
+static double nowNs(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * The original FIGHT loop, counting strikes instead of printing them. The
+ * player only wins by bringing the monster down inside the loop, so a player
+ * who starts at 0 hp or below loses without a blow. Returns 0 if the fight
+ * is still going after ROUND_LIMIT rounds.
+ */
+static int loopFight(int playerHp, int playerAttack, int monsterHp, int monsterAttack, FightResult* r) {
+    FightResult loop = {0};
+    long long php = playerHp;
+    long long mhp = monsterHp;
+
+    while (php > 0) {
+        if (loop.playerStrikes == ROUND_LIMIT)
+            return 0;
+        mhp -= playerAttack;
+        loop.playerStrikes++;
+        if (mhp <= 0) {
+            loop.playerWon = 1;
+            break;
+        }
+
+        php -= monsterAttack;
+        loop.monsterStrikes++;
+    }
+    loop.playerHp = php;
+    loop.monsterHp = mhp;
+    *r = loop;
+    return 1;
+}
+
+static int sameResult(const FightResult* a, const FightResult* b) {
+    return a->playerWon == b->playerWon && a->endless == b->endless
+        && a->playerStrikes == b->playerStrikes && a->monsterStrikes == b->monsterStrikes
+        && a->playerHp == b->playerHp && a->monsterHp == b->monsterHp;
+}
+
+static const char* outcomeName(const FightResult* r) {
+    return r->endless ? "endless" : r->playerWon ? "won" : "lost";
+}
+
+//every combination in [low, high] on all four values, returns the number of mismatches
+static long long checkRange(int low, int high) {
+    long long checked = 0;
+    long long mismatches = 0;
+
+    for (int php = low; php <= high; php++)
+    for (int pa = low; pa <= high; pa++)
+    for (int mhp = low; mhp <= high; mhp++)
+    for (int ma = low; ma <= high; ma++) {
+        FightResult fast = resolveFight(php, pa, mhp, ma);
+        FightResult loop = { .endless = 1 };
+        int finished = loopFight(php, pa, mhp, ma, &loop);
+        checked++;
+        if ((finished ? sameResult(&fast, &loop) : fast.endless) || mismatches++ >= 10)
+            continue;
+        printf("mismatch: player %d hp %d atk, monster %d hp %d atk -> %s, loop says %s\n",
+            php, pa, mhp, ma, outcomeName(&fast), outcomeName(&loop));
+    }
+    printf("%lld fights checked in [%d, %d], %lld mismatches\n", checked, low, high, mismatches);
+    return mismatches;
+}
+
+//combatEvaluate on every player and monster in [low, high], returns the number of mismatches
+static long long checkBatch(int low, int high) {
+    PlayerBatch players;
+    MonsterSoA monsters = {0};
+    long long mismatches = 0;
+
+    playerBatchGrid(&players, low, high, 1, low, high, 1);
+    for (int mhp = low; mhp <= high; mhp++) {
+        for (int ma = low; ma <= high; ma++) {
+            Monster monster = { .hp = mhp, .attack = ma };
+            monsterSoAAdd(&monsters, &monster);
+        }
+    }
+
+    unsigned char* outcome = (unsigned char*)malloc(players.count);
+    int* hpLeft = (int*)malloc(players.count * sizeof(int));
+    if (outcome == NULL || hpLeft == NULL)
+        exit(1);
+
+    for (int m = 0; m < monsters.count; m++) {
+        combatEvaluate(&monsters, m, &players, outcome, hpLeft);
+        for (int i = 0; i < players.count; i++) {
+            FightResult r = resolveFight(players.hp[i], players.attack[i], monsters.hp[m], monsters.attack[m]);
+            int expectOutcome = r.endless ? FIGHT_ENDLESS : r.playerWon ? FIGHT_WON : FIGHT_LOST;
+            long long expectHp = r.playerHp < 0 ? 0 : r.playerHp;
+            if ((outcome[i] == expectOutcome && hpLeft[i] == expectHp) || mismatches++ >= 10)
+                continue;
+            printf("batch mismatch: player %d hp %d atk, monster %d hp %d atk -> %d/%d, expected %d/%lld\n",
+                players.hp[i], players.attack[i], monsters.hp[m], monsters.attack[m],
+                outcome[i], hpLeft[i], expectOutcome, expectHp);
+        }
+    }
+    printf("%lld batch fights checked (%s), %lld mismatches\n",
+        (long long)players.count * monsters.count, combatBackend(), mismatches);
+
+    free(outcome);
+    free(hpLeft);
+    playerBatchFree(&players);
+    monsterSoAFree(&monsters);
+    return mismatches;
+}
+
+//long fights: 1 attack against growing hp, so the loop runs hp rounds
+static void benchLength(int hp) {
+    FightResult r = {0};
+    long long sink = 0;
+
+    double start = nowNs();
+    for (int i = 0; i < TIMED_FIGHTS; i++)
+        sink += resolveFight(hp + i, 1, hp, 1).playerStrikes;
+    double fastNs = (nowNs() - start) / TIMED_FIGHTS;
+
+    start = nowNs();
+    for (int i = 0; i < TIMED_FIGHTS; i++) {
+        loopFight(hp + i, 1, hp, 1, &r);
+        sink += r.playerStrikes;
+    }
+    double loopNs = (nowNs() - start) / TIMED_FIGHTS;
+
+    printf("%9d hp  closed form %8.1f ns  loop %12.1f ns  (%lld)\n", hp, fastNs, loopNs, sink);
+}
+
+int main(int argc, char* argv[]) {
+    int range = argc > 1 ? atoi(argv[1]) : 12;
+    if (range < 1)
+        range = 1;
+
+    long long mismatches = checkRange(-range / 2, range);
+    mismatches += checkBatch(-range / 2, range);
+    for (int hp = 10; hp < ROUND_LIMIT; hp *= 10)
+        benchLength(hp);
+
+    if (mismatches > 0) {
+        fprintf(stderr, "a fight result does not match the round loop\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * Room lookup benchmark: builds square worlds of growing size through
+ * createRoomAt and times room insertion, MOVE style coordinate lookups, a
+ * whole-world win scan (Room objects against the room store bitsets) and
+ * teardown through freeGame, optionally with every room carved from an arena.
+ * Build from the repository root:
+ *   gcc -O2 -I. bench/bench_rooms.c game.c checkpoint.c bst.c btree.c utils.c roomindex.c roomstore.c arena.c render.c intern.c -o bench_rooms
+ * Usage: bench_rooms [maxRooms] [--arena]  (default 1000000 rooms, malloc)
+ */
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "game.h"
+
+#define LOOKUPS_PER_SIZE 1000000
+#define SCAN_PASSES 10
+
+//monotonic enough wall clock in nanoseconds
+static double nowNs(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//small deterministic generator so every run probes the same rooms
+static unsigned int nextRandom(unsigned int* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+//builds a world of n rooms and reports insert and lookup cost per operation
+static void benchSize(int n, int useArena) {
+    GameState g = {0};
+    if (useArena)
+        g.arena = createArena(0);
+    int width = 1;
+    while (width * width < n)
+        width++;
+
+    double start = nowNs();
+    for (int i = 0; i < n; i++)
+        createRoomAt(&g, i % width, i / width);
+    double insertNs = (nowNs() - start) / n;
+
+    unsigned int seed = 12345;
+    int found = 0;
+    start = nowNs();
+    for (int i = 0; i < LOOKUPS_PER_SIZE; i++) {
+        int id = (int)(nextRandom(&seed) % (unsigned int)n);
+        if (findRoomByCoords(&g, id % width, id / width + 1))
+            found++;
+    }
+    double lookupNs = (nowNs() - start) / LOOKUPS_PER_SIZE;
+
+    //same answer both ways: is any room unvisited or still holding a monster
+    int pending = 0;
+    start = nowNs();
+    for (int pass = 0; pass < SCAN_PASSES; pass++) {
+        for (int i = 0; i < n; i++) {
+            Room* room = g.roomTable[i];
+            pending |= !room->visited || room->monster != NULL;
+        }
+    }
+    double objectScanNs = (nowNs() - start) / ((double)n * SCAN_PASSES);
+
+    int cleared = 1;
+    start = nowNs();
+    for (int pass = 0; pass < SCAN_PASSES; pass++)
+        cleared &= roomStoreAllCleared(&g.roomStore);
+    double storeScanNs = (nowNs() - start) / ((double)n * SCAN_PASSES);
+    if (pending == cleared)
+        fprintf(stderr, "win scans disagree at %d rooms\n", n);
+
+    start = nowNs();
+    freeGame(&g);
+    double freeNs = (nowNs() - start) / n;
+
+    printf("%10d rooms: insert %8.1f ns/op, move lookup %8.1f ns/op (%d hits), "
+        "win scan %6.3f / %6.3f ns/room (objects / store), teardown %6.1f ns/room\n",
+        n, insertNs, lookupNs, found, objectScanNs, storeScanNs, freeNs);
+}
+
+int main(int argc, char* argv[]) {
+    int maxRooms = argc > 1 ? atoi(argv[1]) : 1000000;
+    int useArena = argc > 2 && strcmp(argv[2], "--arena") == 0;
+
+    for (int n = 1000; n <= maxRooms; n *= 10)
+        benchSize(n, useArena);
+
+    return 0;
+}
@@ -0,0 +1,394 @@
+/*
+ * Microbenchmark suite: seeded, reproducible workloads for the tree and room
+ * hot paths, reporting ns/op, allocations/op and peak RSS per case.
+ *   bst_insert / bst_find     plain and AVL trees through bstAdd / bstLookup
+ *   bst_insert cow            persistent AVL tree keeping every version, so
+ *                             allocations/op is the path copied per insert
+ *   bst_build / bst_merge     bstBuildSorted from n sorted keys, bstMerge of two
+ *                             n/2 trees (even and odd keys)
+ *   room_add                  createRoomAt, the core of addRoom
+ *   room_find                 findRoomByCoords, half hits and half misses
+ *   display_map               one full status frame, then one cached frame
+ *   free_game                 freeGame, per room
+ * Key orders: sorted, random and adversarial (alternating low/high keys for
+ * the trees, rooms laid out towards negative coordinates so the map grid has
+ * to move its origin).
+ * Build from the repository root:
+ *   gcc -O2 -I. bench/bench_suite.c game.c checkpoint.c bst.c btree.c utils.c roomindex.c roomstore.c arena.c render.c intern.c -o bench_suite
+ * Usage: bench_suite [--max-rooms n] [--max-keys n] [--seed n] [--arena] [--json]
+ *   (defaults: 10^6 rooms, 10^5 keys, seed 42; rooms go up to 10^7)
+ * Allocation counts need glibc (malloc is interposed here), peak RSS needs
+ * getrusage; elsewhere both are reported as unavailable.
+ */
+#define _CRT_SECURE_NO_WARNINGS
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#include "game.h"
+
+#define PLAIN_DEGENERATE_LIMIT 20000    // the plain tree is quadratic on sorted input
+#define DISPLAY_ROOM_LIMIT 1000000      // the legend alone is ~25 bytes per room
+
+typedef enum { SORTED, RANDOM, ADVERSARIAL } KeyOrder;
+
+static const char* orderNames[] = { "sorted", "random", "adversarial" };
+
+static int jsonOutput = 0;
+static int resultCount = 0;
+
+/*
+ * Allocation counter: on glibc the executable's malloc family wins over the
+ * C library's, so every allocation made by the game code lands here.
+ */
+#if defined(__GLIBC__)
+#define COUNT_ALLOCS 1
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+static long long allocCount = 0;
+
+void* malloc(size_t size) {
+    allocCount++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    allocCount++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    allocCount++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+#endif
+
+static long long allocations(void) {
+#ifdef COUNT_ALLOCS
+    return allocCount;
+#else
+    return -1;
+#endif
+}
+
+//high-water mark of the whole process in KB, -1 when unknown
+static long peakRssKb(void) {
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#ifdef __APPLE__
+    return (long)(usage.ru_maxrss / 1024);
+#else
+    return (long)usage.ru_maxrss;
+#endif
+#else
+    return -1;
+#endif
+}
+
+//xorshift32, the same seed always gives the same workload
+static unsigned int nextRandom(unsigned int* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void shuffle(int* values, int n, unsigned int seed) {
+    for (int i = n - 1; i > 0; i--) {
+        int j = (int)(nextRandom(&seed) % (unsigned int)(i + 1));
+        int tmp = values[i];
+        values[i] = values[j];
+        values[j] = tmp;
+    }
+}
+
+//one result line, as a table row or a JSON object
+static void report(const char* bench, const char* variant, KeyOrder order, int n,
+    long long ops, long long ns, long long allocs) {
+    double nsPerOp = ops > 0 ? (double)ns / ops : 0.0;
+    long rss = peakRssKb();
+
+    if (jsonOutput) {
+        printf("%s\n  {\"bench\": \"%s\", \"variant\": \"%s\", \"order\": \"%s\", \"n\": %d, "
+            "\"ops\": %lld, \"ns_per_op\": %.2f, ",
+            resultCount ? "," : "", bench, variant, orderNames[order], n, ops, nsPerOp);
+        if (allocs >= 0)
+            printf("\"allocs_per_op\": %.3f, ", ops > 0 ? (double)allocs / ops : 0.0);
+        else
+            printf("\"allocs_per_op\": null, ");
+        if (rss >= 0)
+            printf("\"peak_rss_kb\": %ld}", rss);
+        else
+            printf("\"peak_rss_kb\": null}");
+    }
+    else {
+        printf("%-12s %-6s %-11s %9d %11.1f ns/op", bench, variant, orderNames[order], n, nsPerOp);
+        if (allocs >= 0)
+            printf(" %8.3f allocs/op", ops > 0 ? (double)allocs / ops : 0.0);
+        else
+            printf("      n/a allocs/op");
+        if (rss >= 0)
+            printf(" %9ld KB peak\n", rss);
+        else
+            printf("       n/a KB peak\n");
+    }
+    resultCount++;
+}
+
+static int compareInts(void* a, void* b) {
+    int x = *(int*)a;
+    int y = *(int*)b;
+    return (x > y) - (x < y);
+}
+
+//0..n-1 in the requested order, adversarial alternates 0, n-1, 1, n-2, ...
+static void makeKeys(int* keys, int n, KeyOrder order, unsigned int seed) {
+    for (int i = 0; i < n; i++) {
+        if (order == ADVERSARIAL)
+            keys[i] = (i % 2 == 0) ? i / 2 : n - 1 - i / 2;
+        else
+            keys[i] = i;
+    }
+    if (order == RANDOM)
+        shuffle(keys, n, seed);
+}
+
+static void benchTree(int balanced, const int* keys, int n, KeyOrder order) {
+    const char* variant = balanced ? "avl" : "plain";
+    if (!balanced && order != RANDOM && n > PLAIN_DEGENERATE_LIMIT)
+        return;
+
+    BST* tree = balanced ? createBalancedBST(compareInts, NULL, NULL)
+                         : createBST(compareInts, NULL, NULL);
+
+    long long allocs = allocations();
+    long long start = nowNanos();
+    for (int i = 0; i < n; i++)
+        bstAdd(tree, (void*)&keys[i]);
+    long long ns = nowNanos() - start;
+    report("bst_insert", variant, order, n, n, ns, allocs < 0 ? -1 : allocations() - allocs);
+
+    int found = 0;
+    allocs = allocations();
+    start = nowNanos();
+    for (int i = 0; i < n; i++)
+        found += bstLookup(tree, (void*)&keys[i]) != NULL;
+    ns = nowNanos() - start;
+    report("bst_find", variant, order, n, n, ns, allocs < 0 ? -1 : allocations() - allocs);
+
+    if (found != n)
+        fprintf(stderr, "bst_find: only %d of %d keys found\n", found, n);
+    bstDestroy(tree);
+}
+
+//persistent tree holding all n + 1 versions until the end
+static void benchVersions(const int* keys, int n, KeyOrder order) {
+    BSTNode** versions = (BSTNode**)malloc((size_t)n * sizeof(BSTNode*));
+    if (versions == NULL)
+        exit(1);
+    BST* tree = createPersistentBST(compareInts, NULL, NULL);
+
+    long long allocs = allocations();
+    long long start = nowNanos();
+    for (int i = 0; i < n; i++) {
+        bstAdd(tree, (void*)&keys[i]);
+        versions[i] = bstVersion(tree);
+    }
+    long long ns = nowNanos() - start;
+    report("bst_insert", "cow", order, n, n, ns, allocs < 0 ? -1 : allocations() - allocs);
+
+    //the oldest version must still hold exactly the first key
+    if (bstCount(tree) != n || versions[0]->size != 1 || versions[0]->data != &keys[0])
+        fprintf(stderr, "bst_insert cow: an old version changed\n");
+    for (int i = 0; i < n; i++)
+        bstRelease(versions[i]);
+    bstDestroy(tree);
+    free(versions);
+}
+
+//bulk paths, independent of the key order, so only run once per size
+static void benchBulk(int n) {
+    int* values = (int*)malloc((size_t)n * sizeof(int));
+    void** data = (void**)malloc((size_t)n * sizeof(void*));
+    if (values == NULL || data == NULL)
+        exit(1);
+    for (int i = 0; i < n; i++) {
+        values[i] = i;
+        data[i] = &values[i];
+    }
+
+    BST* tree = createBalancedBST(compareInts, NULL, NULL);
+    long long allocs = allocations();
+    long long start = nowNanos();
+    bstBuildSorted(tree, data, n);
+    long long ns = nowNanos() - start;
+    report("bst_build", "avl", SORTED, n, n, ns, allocs < 0 ? -1 : allocations() - allocs);
+    bstDestroy(tree);
+
+    //evens in one tree, odds in the other, so the merge interleaves all the way
+    BST* evens = createBalancedBST(compareInts, NULL, NULL);
+    BST* odds = createBalancedBST(compareInts, NULL, NULL);
+    for (int i = 0; i < n; i++)
+        bstAdd(i % 2 ? odds : evens, &values[i]);
+
+    allocs = allocations();
+    start = nowNanos();
+    bstMerge(evens, odds);
+    ns = nowNanos() - start;
+    report("bst_merge", "avl", SORTED, n, n, ns, allocs < 0 ? -1 : allocations() - allocs);
+    bstDestroy(evens);
+    bstDestroy(odds);
+
+    free(data);
+    free(values);
+}
+
+/*
+ * Room coordinates for n rooms on a width x width square: row by row,
+ * shuffled, or row by row towards negative x and y.
+ */
+static void makeRooms(int* xs, int* ys, int n, int width, KeyOrder order, unsigned int seed) {
+    int* cells = (int*)malloc(n * sizeof(int));
+    if (cells == NULL)
+        exit(1);
+    for (int i = 0; i < n; i++)
+        cells[i] = i;
+    if (order == RANDOM)
+        shuffle(cells, n, seed);
+
+    for (int i = 0; i < n; i++) {
+        xs[i] = cells[i] % width;
+        ys[i] = cells[i] / width;
+        if (order == ADVERSARIAL) {
+            xs[i] = -xs[i];
+            ys[i] = -ys[i];
+        }
+    }
+    free(cells);
+}
+
+static void benchRooms(int n, KeyOrder order, int useArena, unsigned int seed) {
+    const char* variant = useArena ? "arena" : "malloc";
+    int width = 1;
+    while (width * width < n)
+        width++;
+
+    int* xs = (int*)malloc(2 * (size_t)n * sizeof(int));
+    if (xs == NULL)
+        exit(1);
+    int* ys = xs + n;
+    makeRooms(xs, ys, n, width, order, seed);
+
+    GameState g = {0};
+    if (useArena)
+        g.arena = createArena(0);
+
+    long long allocs = allocations();
+    long long start = nowNanos();
+    for (int i = 0; i < n; i++)
+        createRoomAt(&g, xs[i], ys[i]);
+    long long ns = nowNanos() - start;
+    report("room_add", variant, order, n, n, ns, allocs < 0 ? -1 : allocations() - allocs);
+
+    //every other probe is one row past the square, so it misses
+    int found = 0;
+    unsigned int probe = seed;
+    allocs = allocations();
+    start = nowNanos();
+    for (int i = 0; i < n; i++) {
+        int k = (int)(nextRandom(&probe) % (unsigned int)n);
+        int y = ys[k] + ((i & 1) ? (order == ADVERSARIAL ? -width : width) : 0);
+        found += findRoomByCoords(&g, xs[k], y) != NULL;
+    }
+    ns = nowNanos() - start;
+    report("room_find", variant, order, n, n, ns, allocs < 0 ? -1 : allocations() - allocs);
+
+    if (n <= DISPLAY_ROOM_LIMIT) {
+        //the first frame formats everything, the second reuses the caches
+        for (int pass = 0; pass < 2; pass++) {
+            allocs = allocations();
+            start = nowNanos();
+            fbBegin(&g.frame);
+            displayGameStatus(&g);
+            ns = nowNanos() - start;
+            report("display_map", pass == 0 ? "full" : "cached", order, n, 1, ns,
+                allocs < 0 ? -1 : allocations() - allocs);
+        }
+    }
+
+    allocs = allocations();
+    start = nowNanos();
+    freeGame(&g);
+    ns = nowNanos() - start;
+    report("free_game", variant, order, n, n, ns, allocs < 0 ? -1 : allocations() - allocs);
+
+    free(xs);
+}
+
+int main(int argc, char* argv[]) {
+    int maxRooms = 1000000;
+    int maxKeys = 100000;
+    unsigned int seed = 42;
+    int useArena = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--max-rooms") == 0 && i + 1 < argc)
+            maxRooms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max-keys") == 0 && i + 1 < argc)
+            maxKeys = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--arena") == 0)
+            useArena = 1;
+        else if (strcmp(argv[i], "--json") == 0)
+            jsonOutput = 1;
+        else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    //xorshift never leaves 0
+    if (seed == 0)
+        seed = 1;
+
+    if (jsonOutput)
+        printf("{\"suite\": \"bench_suite\", \"version\": 1, \"seed\": %u, \"results\": [", seed);
+
+    int* keys = (int*)malloc((maxKeys > 0 ? maxKeys : 1) * sizeof(int));
+    if (keys == NULL)
+        return 1;
+    for (int n = 1000; n <= maxKeys; n *= 10) {
+        for (int order = SORTED; order <= ADVERSARIAL; order++) {
+            makeKeys(keys, n, (KeyOrder)order, seed);
+            benchTree(0, keys, n, (KeyOrder)order);
+            benchTree(1, keys, n, (KeyOrder)order);
+            benchVersions(keys, n, (KeyOrder)order);
+        }
+        benchBulk(n);
+    }
+    free(keys);
+
+    for (int n = 1000; n <= maxRooms; n *= 10) {
+        for (int order = SORTED; order <= ADVERSARIAL; order++)
+            benchRooms(n, (KeyOrder)order, useArena, seed);
+    }
+
+    if (jsonOutput)
+        printf("\n]}\n");
+    return 0;
+}
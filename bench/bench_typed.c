@@ -0,0 +1,201 @@
+/*
+ * Typed tree benchmark: the same bag and defeated-monster workloads through
+ * the generic BST (void* nodes, compareItems/compareMonsters callbacks) and
+ * through ItemTree/MonsterTree (elements stored in the node, comparison
+ * inlined). Names come from a small pool with shared prefixes, interned the
+ * way the game does, so ties on name fall through to the numeric fields.
+ * Each size inserts n elements, then does n lookups, half of them misses,
+ * and cross-checks the two trees against each other.
+ * Build from the repository root:
+ *   gcc -O2 -I. bench/bench_typed.c typedtrees.c game.c checkpoint.c bst.c btree.c utils.c roomindex.c roomstore.c arena.c render.c intern.c -o bench_typed
+ * Usage: bench_typed [maxN] [--seed n]  (default 1000000, seed 42)
+ */
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "game.h"
+#include "typedtrees.h"
+
+#define NAME_POOL 512
+
+static const char* stems[] = { "Sword", "Shield", "Armor", "Spider", "Phantom",
+                               "Golem", "Cobra", "Demon", "Longsword", "Longbow" };
+
+//xorshift32, the same seed always gives the same workload
+static unsigned int nextRandom(unsigned int* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+//pool names look like "Spider17", interned so equal names share a pointer
+static void makeNames(NameTable* names, const char** pool) {
+    char buffer[32];
+    int stemCount = (int)(sizeof(stems) / sizeof(stems[0]));
+    for (int i = 0; i < NAME_POOL; i++) {
+        sprintf(buffer, "%s%d", stems[i % stemCount], i / stemCount);
+        pool[i] = internName(names, buffer, NULL);
+    }
+}
+
+static void makeItems(Item* items, int n, const char** pool, unsigned int* seed) {
+    for (int i = 0; i < n; i++) {
+        items[i].name = (char*)pool[nextRandom(seed) % NAME_POOL];
+        items[i].sortKey = nameSortKey(items[i].name);
+        items[i].type = (ItemType)(nextRandom(seed) & 1);
+        items[i].value = (int)(nextRandom(seed) % 1000);
+    }
+}
+
+static void makeMonsters(Monster* monsters, int n, const char** pool, unsigned int* seed) {
+    for (int i = 0; i < n; i++) {
+        monsters[i].name = (char*)pool[nextRandom(seed) % NAME_POOL];
+        monsters[i].sortKey = nameSortKey(monsters[i].name);
+        monsters[i].type = (MonsterType)(nextRandom(seed) % 5);
+        monsters[i].hp = (int)(nextRandom(seed) % 1000) + 1;
+        monsters[i].maxHp = monsters[i].hp;
+        monsters[i].attack = (int)(nextRandom(seed) % 100) + 1;
+    }
+}
+
+//collects the inorder sequence of either tree for the cross-check
+typedef struct {
+    const void** seen;
+    int count;
+} Listing;
+
+static void listGeneric(void* data, void* ctx) {
+    Listing* l = (Listing*)ctx;
+    l->seen[l->count++] = data;
+}
+
+static void report(const char* bench, int n, long long genericNs, long long typedNs) {
+    printf("%-16s %9d %10.1f ns/op generic %10.1f ns/op typed  x%.2f\n", bench, n,
+        (double)genericNs / n, (double)typedNs / n,
+        typedNs > 0 ? (double)genericNs / typedNs : 0.0);
+}
+
+/*
+ * Generic and typed runs of one element type, written once as a macro
+ * because only the type, tree prefix and comparator change.
+ */
+#define RUN_CASE(Type, Tree, prefix, order, compareGeneric, label, mismatch)     \
+    do {                                                                        \
+        BST* generic = createBalancedBST(compareGeneric, NULL, NULL);           \
+        long long start = nowNanos();                                           \
+        for (int i = 0; i < n; i++)                                             \
+            bstAdd(generic, &elems[i]);                                         \
+        long long genericAdd = nowNanos() - start;                              \
+                                                                                \
+        Tree* typed = prefix##Create();                                         \
+        start = nowNanos();                                                     \
+        for (int i = 0; i < n; i++)                                             \
+            prefix##Add(typed, &elems[i]);                                      \
+        long long typedAdd = nowNanos() - start;                                \
+        report(label "_insert", n, genericAdd, typedAdd);                       \
+                                                                                \
+        int genericFound = 0, typedFound = 0;                                   \
+        start = nowNanos();                                                     \
+        for (int i = 0; i < n; i++)                                             \
+            genericFound += bstLookup(generic, &probes[i]) != NULL;             \
+        long long genericFind = nowNanos() - start;                             \
+        start = nowNanos();                                                     \
+        for (int i = 0; i < n; i++)                                             \
+            typedFound += prefix##Lookup(typed, &probes[i]) != NULL;            \
+        long long typedFind = nowNanos() - start;                               \
+        report(label "_find", n, genericFind, typedFind);                       \
+                                                                                \
+        Listing l = { seen, 0 };                                                \
+        bstForEach(generic, BST_INORDER, listGeneric, &l);                      \
+        for (int i = 1; i < l.count; i++)                                       \
+            if (order((const Type*)seen[i - 1], (const Type*)seen[i]) > 0)      \
+                mismatch = 1;                                                   \
+        for (int i = 0; i < n; i++) {                                           \
+            Type* hit = prefix##Lookup(typed, (const Type*)seen[i]);            \
+            if (hit == NULL || order(hit, (const Type*)seen[i]) != 0)           \
+                mismatch = 1;                                                   \
+        }                                                                       \
+        if (genericFound != typedFound || typed->count != n)                    \
+            mismatch = 1;                                                       \
+        bstDestroy(generic);                                                    \
+        prefix##Destroy(typed);                                                 \
+    } while (0)
+
+static int benchItems(int n, const char** pool, unsigned int seed, const void** seen) {
+    Item* elems = (Item*)malloc(2 * (size_t)n * sizeof(Item));
+    if (elems == NULL)
+        exit(1);
+    Item* probes = elems + n;
+    makeItems(elems, n, pool, &seed);
+    //every other probe has a value no item has, so it misses
+    for (int i = 0; i < n; i++) {
+        probes[i] = elems[nextRandom(&seed) % (unsigned int)n];
+        if (i & 1)
+            probes[i].value += 1000;
+    }
+
+    int mismatch = 0;
+    RUN_CASE(Item, ItemTree, itemTree, itemOrder, compareItems, "bag", mismatch);
+    free(elems);
+    return !mismatch;
+}
+
+static int benchMonsters(int n, const char** pool, unsigned int seed, const void** seen) {
+    Monster* elems = (Monster*)malloc(2 * (size_t)n * sizeof(Monster));
+    if (elems == NULL)
+        exit(1);
+    Monster* probes = elems + n;
+    makeMonsters(elems, n, pool, &seed);
+    for (int i = 0; i < n; i++) {
+        probes[i] = elems[nextRandom(&seed) % (unsigned int)n];
+        if (i & 1)
+            probes[i].attack += 100;
+    }
+
+    int mismatch = 0;
+    RUN_CASE(Monster, MonsterTree, monsterTree, monsterOrder, compareMonsters, "defeated", mismatch);
+    free(elems);
+    return !mismatch;
+}
+
+int main(int argc, char* argv[]) {
+    int maxN = 1000000;
+    unsigned int seed = 42;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        else
+            maxN = atoi(argv[i]);
+    }
+    //xorshift never leaves 0
+    if (seed == 0)
+        seed = 1;
+    if (maxN < 1000)
+        maxN = 1000;
+
+    NameTable names = {0};
+    const char* pool[NAME_POOL];
+    makeNames(&names, pool);
+
+    const void** seen = (const void**)malloc((size_t)maxN * sizeof(void*));
+    if (seen == NULL)
+        return 1;
+
+    int ok = 1;
+    for (int n = 1000; n <= maxN; n *= 10) {
+        ok &= benchItems(n, pool, seed, seen);
+        ok &= benchMonsters(n, pool, seed, seen);
+    }
+
+    free(seen);
+    nameTableFree(&names);
+    if (!ok) {
+        fprintf(stderr, "typed and generic trees disagree\n");
+        return 1;
+    }
+    return 0;
+}
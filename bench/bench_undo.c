@@ -0,0 +1,157 @@
+/*
+ * Checkpoint benchmark: "try this move, then roll back" on generated
+ * dungeons of growing size.
+ *   rebuild   simGenerateWorld plus CMD_INIT_PLAYER, the restart the
+ *             checkpoints replace
+ *   undo      gameCheckpoint, a burst of bot steps, gameRestore
+ * The bursts walk, fight and pick up at random, so the journal only ever
+ * holds the rooms they touched and undo should stay flat as rooms grow.
+ * Every restore is checked against the state saved before the burst.
+ * Build from the repository root:
+ *   gcc -O2 -I. bench/bench_undo.c sim.c game.c checkpoint.c bst.c btree.c utils.c roomindex.c roomstore.c arena.c render.c intern.c -pthread -o bench_undo
+ * Usage: bench_undo [maxRooms] [--steps n] [--seed n]  (default 100000, 16 steps, seed 42)
+ */
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checkpoint.h"
+#include "sim.h"
+
+#define UNDO_ROUNDS 10000
+
+//xorshift32, the same seed always gives the same workload
+static unsigned int nextRandom(unsigned int* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+//the state a burst may touch, compared before and after each undo
+typedef struct {
+    Room* room;
+    int hp;
+    int bagCount;
+    int defeatedCount;
+    int unvisitedRooms;
+    int monstersRemaining;
+} UndoCheck;
+
+static UndoCheck takeCheck(GameState* g) {
+    UndoCheck c = { g->player->currentRoom, g->player->hp, bstCount(g->player->bag),
+                    bstCount(g->player->defeatedMonsters), g->unvisitedRooms, g->monstersRemaining };
+    return c;
+}
+
+static int sameCheck(const UndoCheck* a, const UndoCheck* b) {
+    return a->room == b->room && a->hp == b->hp && a->bagCount == b->bagCount
+        && a->defeatedCount == b->defeatedCount && a->unvisitedRooms == b->unvisitedRooms
+        && a->monstersRemaining == b->monstersRemaining;
+}
+
+//one random step from the current room: fight, pick up or walk to a neighbour
+static void botStep(GameState* g, unsigned int* seed) {
+    Room* room = g->player->currentRoom;
+    Command cmd = { .type = CMD_MOVE };
+    StepOutput out;
+
+    if (room->monster != NULL)
+        cmd.type = CMD_FIGHT;
+    else if (room->item != NULL && bstLookup(g->player->bag, room->item) == NULL)
+        cmd.type = CMD_PICKUP;
+    else {
+        //first existing neighbour from a random starting direction
+        static const int stepX[4] = { 0, 0, -1, 1 };
+        static const int stepY[4] = { -1, 1, 0, 0 };
+        int first = (int)(nextRandom(seed) % 4);
+        for (int i = 0; i < 4; i++) {
+            int d = (first + i) % 4;
+            cmd.direction = (Direction)d;
+            if (findRoomByCoords(g, room->x + stepX[d], room->y + stepY[d]) != NULL)
+                break;
+        }
+    }
+    gameStep(g, &cmd, &out);
+}
+
+static int benchSize(int rooms, int steps, unsigned int seed) {
+    SimConfig config;
+    simDefaultConfig(&config);
+    config.rooms = rooms;
+    config.seed = seed;
+    //strong enough that most bursts fight and survive
+    config.maxHp = 1000000;
+    config.baseAttack = 50;
+
+    GameState g = {0};
+    g.configMaxHp = config.maxHp;
+    g.configBaseAttack = config.baseAttack;
+    g.arena = createArena(0);
+    checkpointEnable(&g);
+
+    unsigned long long rng = config.seed;
+    Command init = { .type = CMD_INIT_PLAYER };
+    StepOutput out;
+    long long start = nowNanos();
+    simGenerateWorld(&g, &config, &rng);
+    gameStep(&g, &init, &out);
+    long long rebuildNs = nowNanos() - start;
+
+    int ok = 1;
+    long long journaled = 0;
+    start = nowNanos();
+    for (int round = 0; round < UNDO_ROUNDS; round++) {
+        UndoCheck before = takeCheck(&g);
+        int id = gameCheckpoint(&g);
+        for (int i = 0; i < steps; i++)
+            botStep(&g, &seed);
+        journaled += g.history->roomCount;
+        gameRestore(&g, id);
+        UndoCheck after = takeCheck(&g);
+        ok &= sameCheck(&before, &after);
+
+        //move on between rounds so the bursts start from different rooms
+        gameDropCheckpoints(&g);
+        botStep(&g, &seed);
+    }
+    long long undoNs = nowNanos() - start;
+
+    printf("%9d rooms  rebuild %12.1f us  undo %8.1f ns  %5.1f rooms journaled  x%.0f\n",
+        rooms, rebuildNs / 1000.0, (double)undoNs / UNDO_ROUNDS, (double)journaled / UNDO_ROUNDS,
+        undoNs > 0 ? (double)rebuildNs * UNDO_ROUNDS / undoNs : 0.0);
+
+    freeGame(&g);
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    int maxRooms = 100000;
+    int steps = 16;
+    unsigned int seed = 42;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc)
+            steps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        else
+            maxRooms = atoi(argv[i]);
+    }
+    //xorshift never leaves 0
+    if (seed == 0)
+        seed = 1;
+    if (maxRooms < 1000)
+        maxRooms = 1000;
+
+    int ok = 1;
+    for (int rooms = 1000; rooms <= maxRooms; rooms *= 10)
+        ok &= benchSize(rooms, steps, seed);
+
+    if (!ok) {
+        fprintf(stderr, "a restore did not bring the game back\n");
+        return 1;
+    }
+    return 0;
+}
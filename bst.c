@@ -1,5 +1,17 @@
 #include <stdlib.h>
+#include <string.h>
 #include "bst.h"
+#include "btree.h"
+#include "prof.h"
+
+static BSTNode* createNode(void* data, Arena* arena, const BSTAggregate* agg);
+static BSTNode* plainInsert(BSTNode* root, void* data, int (*cmp)(void*, void*), Arena* arena,
+    const BSTAggregate* agg);
+static BSTNode* balancedInsert(BSTNode* root, void* data, int (*cmp)(void*, void*), Arena* arena,
+    const BSTAggregate* agg);
+static BSTNode* persistentInsert(BSTNode* node, void* data, int (*cmp)(void*, void*),
+    const BSTAggregate* agg, int consume);
+static void iterPush(BSTIterator* it, BSTNode* node);
 
 BST* createBST(int (*cmp)(void*, void*), void (*print)(void*), void (*freeData)(void*)) {
 
@@ -10,86 +22,474 @@ BST* createBST(int (*cmp)(void*, void*), void (*print)(void*), void (*freeData)(
     newBST->compare = cmp;
     newBST->freeData = freeData;
     newBST->print = print;
+    newBST->balanced = 0;
+    newBST->persistent = 0;
+    newBST->arena = NULL;
+    newBST->btree = NULL;
+    newBST->aggregate = NULL;
+    newBST->total = NULL;
 
     return newBST;
 }
 
-//main function to create a Node
+//creates a tree that keeps itself balanced (AVL) on every insert
+BST* createBalancedBST(int (*cmp)(void*, void*), void (*print)(void*), void (*freeData)(void*)) {
+    BST* newBST = createBST(cmp, print, freeData);
+    newBST->balanced = 1;
+    return newBST;
+}
+
+/*
+ * Creates a tree backed by a B-tree: bstAdd copies each element of elemSize
+ * bytes into the tree and hands the original to freeData right away, the
+ * copies themselves are never passed to freeData.
+ */
+BST* createBTreeBST(size_t elemSize, int (*cmp)(void*, void*), void (*print)(void*), void (*freeData)(void*)) {
+    BST* newBST = createBST(cmp, print, freeData);
+    newBST->balanced = 1;
+    newBST->btree = createBTree(elemSize, cmp);
+    return newBST;
+}
+
+/*
+ * Creates a balanced tree whose versions can be kept: bstVersion hands out
+ * the current root, which later inserts leave untouched, and bstSetVersion
+ * goes back to one. Nodes always come from malloc, even with an arena set.
+ * Old versions share the elements, so freeData only sees the elements of
+ * the current version, when the tree is destroyed.
+ */
+BST* createPersistentBST(int (*cmp)(void*, void*), void (*print)(void*), void (*freeData)(void*)) {
+    BST* newBST = createBST(cmp, print, freeData);
+    newBST->balanced = 1;
+    newBST->persistent = 1;
+    return newBST;
+}
+
+//main function to create a Node, equal keys go to the right
 BSTNode* bstInsert(BSTNode* root, void* data, int (*cmp)(void*, void*)) {
+    return plainInsert(root, data, cmp, NULL, NULL);
+}
+
+//aggregate stored right behind a node
+static void* nodeAggregate(BSTNode* node) {
+    return node + 1;
+}
+
+static BSTNode* plainInsert(BSTNode* root, void* data, int (*cmp)(void*, void*), Arena* arena,
+    const BSTAggregate* agg) {
+    BSTNode* newNode = createNode(data, arena, agg);
     if (root == NULL)
-        return createNode(data);
+        return newNode;
 
-    if (cmp(data, root->data) < 0)
-        root->left = bstInsert(root->left, data, cmp);
-    else
-        root->right = bstInsert(root->right, data, cmp);
+    //walk down iteratively so degenerate trees cannot blow the stack,
+    //every node on the way gains the new element
+    BSTNode* iterNode = root;
+    while (1) {
+        iterNode->size++;
+        if (agg != NULL)
+            agg->combine(nodeAggregate(iterNode), nodeAggregate(newNode));
+
+        if (cmp(data, iterNode->data) < 0) {
+            if (iterNode->left == NULL) {
+                iterNode->left = newNode;
+                break;
+            }
+            iterNode = iterNode->left;
+        }
+        else {
+            if (iterNode->right == NULL) {
+                iterNode->right = newNode;
+                break;
+            }
+            iterNode = iterNode->right;
+        }
+    }
 
     return root;
 }
 
-//helper function to add a node
-static BSTNode* createNode(void* data) {
-    BSTNode* newNode = (BSTNode*)malloc(sizeof(BSTNode));
-    if (newNode == NULL) {
-        exit(1);
+//height of a subtree, an empty subtree has height 0
+static int nodeHeight(BSTNode* node) {
+    return node ? node->height : 0;
+}
+
+static int nodeSize(BSTNode* node) {
+    return node ? node->size : 0;
+}
+
+//recomputes height, size and aggregate of node from its children
+static void updateNode(BSTNode* node, const BSTAggregate* agg) {
+    int lh = nodeHeight(node->left);
+    int rh = nodeHeight(node->right);
+    node->height = (lh > rh ? lh : rh) + 1;
+    node->size = nodeSize(node->left) + nodeSize(node->right) + 1;
+
+    if (agg != NULL) {
+        agg->init(nodeAggregate(node), node->data);
+        if (node->left)
+            agg->combine(nodeAggregate(node), nodeAggregate(node->left));
+        if (node->right)
+            agg->combine(nodeAggregate(node), nodeAggregate(node->right));
+    }
+}
+
+static BSTNode* rotateRight(BSTNode* node, const BSTAggregate* agg) {
+    BSTNode* pivot = node->left;
+    node->left = pivot->right;
+    pivot->right = node;
+    updateNode(node, agg);
+    updateNode(pivot, agg);
+    return pivot;
+}
+
+static BSTNode* rotateLeft(BSTNode* node, const BSTAggregate* agg) {
+    BSTNode* pivot = node->right;
+    node->right = pivot->left;
+    pivot->left = node;
+    updateNode(node, agg);
+    updateNode(pivot, agg);
+    return pivot;
+}
+
+//restores the AVL property at node, returns the new subtree root
+static BSTNode* rebalance(BSTNode* node, const BSTAggregate* agg) {
+    updateNode(node, agg);
+    int balance = nodeHeight(node->left) - nodeHeight(node->right);
+
+    if (balance > 1) {
+        if (nodeHeight(node->left->left) < nodeHeight(node->left->right))
+            node->left = rotateLeft(node->left, agg);
+        return rotateRight(node, agg);
     }
+    if (balance < -1) {
+        if (nodeHeight(node->right->right) < nodeHeight(node->right->left))
+            node->right = rotateRight(node->right, agg);
+        return rotateLeft(node, agg);
+    }
+    return node;
+}
+
+/*
+ * AVL insert with the same ordering as bstInsert (equal keys go right).
+ * Depth is O(log n) so the recursion is bounded.
+ */
+BSTNode* bstInsertBalanced(BSTNode* root, void* data, int (*cmp)(void*, void*)) {
+    return balancedInsert(root, data, cmp, NULL, NULL);
+}
+
+static BSTNode* balancedInsert(BSTNode* root, void* data, int (*cmp)(void*, void*), Arena* arena,
+    const BSTAggregate* agg) {
+    if (root == NULL)
+        return createNode(data, arena, agg);
+
+    if (cmp(data, root->data) < 0)
+        root->left = balancedInsert(root->left, data, cmp, arena, agg);
+    else
+        root->right = balancedInsert(root->right, data, cmp, arena, agg);
+
+    return rebalance(root, agg);
+}
+
+static void initNode(BSTNode* newNode, void* data, const BSTAggregate* agg) {
     newNode->data = data;
     newNode->left = NULL;
     newNode->right = NULL;
+    newNode->height = 1;
+    newNode->size = 1;
+    if (agg != NULL)
+        agg->init(nodeAggregate(newNode), data);
+}
+
+//helper function to add a node, taken from the arena when one is given
+static BSTNode* createNode(void* data, Arena* arena, const BSTAggregate* agg) {
+    size_t size = sizeof(BSTNode) + (agg ? agg->size : 0);
+    BSTNode* newNode;
+    if (arena != NULL)
+        newNode = (BSTNode*)arenaAlloc(arena, size);
+    else
+        newNode = (BSTNode*)malloc(size);
+    if (newNode == NULL) {
+        exit(1);
+    }
+    initNode(newNode, data, agg);
     return newNode;
 }
 
-//realses tree memory safely
-void bstFree(BSTNode* root, void (*freeData)(void*)) {
-    //stop condition
+/*
+ * Persistent nodes carry their reference count in front of the node: one
+ * per parent pointing at it and one per version root held from outside.
+ * The aggregate keeps its place right behind the node.
+ */
+typedef struct {
+    long long refs;
+} PersistentHeader;
+
+static long long* nodeRefs(BSTNode* node) {
+    return &((PersistentHeader*)node - 1)->refs;
+}
+
+static BSTNode* allocPersistentNode(const BSTAggregate* agg) {
+    PersistentHeader* header = (PersistentHeader*)malloc(sizeof(PersistentHeader)
+        + sizeof(BSTNode) + (agg ? agg->size : 0));
+    if (header == NULL)
+        exit(1);
+    header->refs = 1;
+    return (BSTNode*)(header + 1);
+}
+
+static BSTNode* createPersistentNode(void* data, const BSTAggregate* agg) {
+    BSTNode* newNode = allocPersistentNode(agg);
+    initNode(newNode, data, agg);
+    return newNode;
+}
+
+//private copy of a shared node, its children gain the copy as a second parent
+static BSTNode* copyPersistentNode(BSTNode* node, const BSTAggregate* agg) {
+    BSTNode* copy = allocPersistentNode(agg);
+    memcpy(copy, node, sizeof(BSTNode) + (agg ? agg->size : 0));
+    bstRetain(copy->left);
+    bstRetain(copy->right);
+    return copy;
+}
+
+//node of the right kind for the tree: persistent, from its arena or from malloc
+static BSTNode* createTreeNode(BST* tree, void* data) {
+    if (tree->persistent)
+        return createPersistentNode(data, tree->aggregate);
+    return createNode(data, tree->arena, tree->aggregate);
+}
+
+//one more holder of the version at root, returns root
+BSTNode* bstRetain(BSTNode* root) {
+    if (root != NULL)
+        (*nodeRefs(root))++;
+    return root;
+}
+
+//drops one hold on a version, freeing the nodes no other version uses
+void bstRelease(BSTNode* root) {
     if (root == NULL)
         return;
 
-    //recursion steps to bith sides
-    bstFree(root->right, freeData);
-    bstFree(root->left, freeData);
+    //only the nodes that drop to zero are expanded, shared subtrees stop the walk
+    BSTIterator it;
+    bstIterBegin(&it, NULL, BST_PREORDER);
+    iterPush(&it, root);
+    while (it.top > 0) {
+        BSTNode* node = it.stack[--it.top];
+        if (--*nodeRefs(node) > 0)
+            continue;
+        if (node->left)
+            iterPush(&it, node->left);
+        if (node->right)
+            iterPush(&it, node->right);
+        free((PersistentHeader*)node - 1);
+    }
+    bstIterEnd(&it);
+}
+
+//new version holding data as well, root stays a valid version on its own
+BSTNode* bstInsertPersistent(BSTNode* root, void* data, int (*cmp)(void*, void*)) {
+    return persistentInsert(root, data, cmp, NULL, 0);
+}
+
+/*
+ * Path copying AVL insert. With consume set the caller gives up its hold
+ * on node, so a node nobody else holds is updated in place; a shared one
+ * is copied. Below the top the copy's own hold on the child is given up,
+ * so children are copied exactly when another version still uses them.
+ * Rotations only touch nodes on the insert path, which are private by then.
+ */
+static BSTNode* persistentInsert(BSTNode* node, void* data, int (*cmp)(void*, void*),
+    const BSTAggregate* agg, int consume) {
+    if (node == NULL)
+        return createPersistentNode(data, agg);
+
+    BSTNode* target = node;
+    if (!consume || *nodeRefs(node) > 1) {
+        target = copyPersistentNode(node, agg);
+        //still held by another version, so this never frees it
+        if (consume)
+            (*nodeRefs(node))--;
+    }
+
+    if (cmp(data, target->data) < 0)
+        target->left = persistentInsert(target->left, data, cmp, agg, 1);
+    else
+        target->right = persistentInsert(target->right, data, cmp, agg, 1);
+
+    return rebalance(target, agg);
+}
+
+//realses tree memory safely, without recursion or an explicit stack
+void bstFree(BSTNode* root, void (*freeData)(void*)) {
+    BSTNode* iterNode = root;
+
+    while (iterNode != NULL) {
+        //rotate left children up until the node has none, then free it
+        if (iterNode->left != NULL) {
+            BSTNode* leftNode = iterNode->left;
+            iterNode->left = leftNode->right;
+            leftNode->right = iterNode;
+            iterNode = leftNode;
+            continue;
+        }
+
+        BSTNode* nextNode = iterNode->right;
+
+        //to be on safe side - if func exists
+        if (freeData != NULL)
+            freeData(iterNode->data);
+
+        free(iterNode);
+        iterNode = nextNode;
+    }
+}
+
+static void iterPush(BSTIterator* it, BSTNode* node) {
+    if (it->top == it->capacity) {
+        int newCapacity = it->capacity * 2;
+        BSTNode** newStack;
+        if (it->stack == it->inlineStack) {
+            newStack = (BSTNode**)malloc(newCapacity * sizeof(BSTNode*));
+            if (newStack != NULL)
+                for (int i = 0; i < it->top; i++)
+                    newStack[i] = it->stack[i];
+        }
+        else {
+            newStack = (BSTNode**)realloc(it->stack, newCapacity * sizeof(BSTNode*));
+        }
+        if (newStack == NULL)
+            exit(1);
+
+        it->stack = newStack;
+        it->capacity = newCapacity;
+    }
+    it->stack[it->top++] = node;
+}
+
+//starts a traversal of root in the given order
+void bstIterBegin(BSTIterator* it, BSTNode* root, BSTOrder order) {
+    it->stack = it->inlineStack;
+    it->top = 0;
+    it->capacity = BST_ITER_INLINE_DEPTH;
+    it->order = order;
+    it->current = root;
+    it->lastVisited = NULL;
+
+    if (order == BST_PREORDER && root != NULL)
+        iterPush(it, root);
+}
+
+//returns the next data in the traversal, NULL once every node was visited
+void* bstIterNext(BSTIterator* it) {
+    BSTNode* node = bstIterNextNode(it);
+    return node ? node->data : NULL;
+}
+
+//same traversal as bstIterNext but hands out the nodes themselves
+BSTNode* bstIterNextNode(BSTIterator* it) {
+    switch (it->order) {
+    case BST_PREORDER:
+    {
+        if (it->top == 0)
+            return NULL;
+
+        BSTNode* node = it->stack[--it->top];
+        if (node->right)
+            iterPush(it, node->right);
+        if (node->left)
+            iterPush(it, node->left);
+        return node;
+    }
+
+    case BST_INORDER:
+    {
+        while (it->current != NULL) {
+            iterPush(it, it->current);
+            it->current = it->current->left;
+        }
+        if (it->top == 0)
+            return NULL;
 
-    //to be on safe side - if func exists
-    if (freeData != NULL)
-        freeData(root->data);
+        BSTNode* node = it->stack[--it->top];
+        it->current = node->right;
+        return node;
+    }
+
+    case BST_POSTORDER:
+    {
+        while (1) {
+            while (it->current != NULL) {
+                iterPush(it, it->current);
+                it->current = it->current->left;
+            }
+            if (it->top == 0)
+                return NULL;
+
+            //go right first unless we are coming back from there
+            BSTNode* node = it->stack[it->top - 1];
+            if (node->right != NULL && node->right != it->lastVisited) {
+                it->current = node->right;
+                continue;
+            }
+
+            it->top--;
+            it->lastVisited = node;
+            return node;
+        }
+    }
+    }
+
+    return NULL;
+}
+
+//releases the iterator stack if it had to grow onto the heap
+void bstIterEnd(BSTIterator* it) {
+    if (it->stack != it->inlineStack)
+        free(it->stack);
+    it->stack = it->inlineStack;
+    it->top = 0;
+}
+
+//calls visit(data, ctx) for every node in the given order
+void bstVisit(BSTNode* root, BSTOrder order, void (*visit)(void* data, void* ctx), void* ctx) {
+    BSTIterator it;
+    void* data;
+
+    bstIterBegin(&it, root, order);
+    while ((data = bstIterNext(&it)) != NULL)
+        visit(data, ctx);
+    bstIterEnd(&it);
+}
+
+//shared loop of the three print traversals
+static void printInOrder(BSTNode* root, BSTOrder order, void (*print)(void*)) {
+    if (!print)
+        return;
+
+    BSTIterator it;
+    void* data;
 
-    free(root);
+    bstIterBegin(&it, root, order);
+    while ((data = bstIterNext(&it)) != NULL)
+        print(data);
+    bstIterEnd(&it);
 }
 
 //prints in order
 void bstInorder(BSTNode* root, void (*print)(void*)) {
-    if (!root)
-        return;
- 
-    bstInorder(root->left, print);
-    
-    if (print)
-        print(root->data);
-    
-    bstInorder(root->right, print);          
+    printInOrder(root, BST_INORDER, print);
 }
 
 //prints preorder
 void bstPreorder(BSTNode* root, void (*print)(void*)) {
-    if (!root)
-        return;
-
-    if (print)
-        print(root->data);
-
-    bstPreorder(root->left, print);
-    bstPreorder(root->right, print);
+    printInOrder(root, BST_PREORDER, print);
 }
 
 //prints post order
 void bstPostorder(BSTNode* root, void (*print)(void*)) {
-    if (!root)
-        return;
-
-    bstPostorder(root->left, print);
-    bstPostorder(root->right, print);
-    if (print)
-        print(root->data);
+    printInOrder(root, BST_POSTORDER, print);
 }
 
 //search for node equal data
@@ -104,4 +504,684 @@ void* bstFind(BSTNode* root, void* data, int (*cmp)(void*, void*)) {
     }
 
     return NULL;
-}
\ No newline at end of file
+}
+
+//makes all future nodes of an empty tree come from the arena
+void bstUseArena(BST* tree, Arena* arena) {
+    tree->arena = arena;
+    if (tree->btree != NULL)
+        btreeUseArena(tree->btree, arena);
+}
+
+//B-tree backend: folds one more element into the tree-wide aggregate
+static void foldTotal(BST* tree, void* data) {
+    unsigned char one[BST_AGGREGATE_MAX];
+
+    if (tree->total == NULL) {
+        tree->total = malloc(tree->aggregate->size);
+        if (tree->total == NULL)
+            exit(1);
+        tree->aggregate->init(tree->total, data);
+        return;
+    }
+    tree->aggregate->init(one, data);
+    tree->aggregate->combine(tree->total, one);
+}
+
+/*
+ * Inserts using the tree's compare function and balancing mode. Returns the
+ * stored element: data itself, or its copy in a B-tree backed tree.
+ */
+void* bstAdd(BST* tree, void* data) {
+    PROF_START(add);
+    if (tree->btree != NULL) {
+        void* stored = btreeInsert(tree->btree, data);
+        if (tree->aggregate != NULL)
+            foldTotal(tree, stored);
+        if (tree->freeData != NULL)
+            tree->freeData(data);
+        PROF_STOP(add, PROF_BST_ADD);
+        return stored;
+    }
+    if (tree->persistent)
+        tree->root = persistentInsert(tree->root, data, tree->compare, tree->aggregate, 1);
+    else if (tree->balanced)
+        tree->root = balancedInsert(tree->root, data, tree->compare, tree->arena, tree->aggregate);
+    else
+        tree->root = plainInsert(tree->root, data, tree->compare, tree->arena, tree->aggregate);
+    PROF_STOP(add, PROF_BST_ADD);
+    return data;
+}
+
+//search the tree with its own compare function
+void* bstLookup(BST* tree, void* data) {
+    PROF_START(lookup);
+    void* found = tree->btree ? btreeFind(tree->btree, data) : bstFind(tree->root, data, tree->compare);
+    PROF_STOP(lookup, PROF_BST_LOOKUP);
+    return found;
+}
+
+//visits every element of the tree in the given order
+void bstForEach(BST* tree, BSTOrder order, void (*visit)(void* data, void* ctx), void* ctx) {
+    if (tree->btree != NULL)
+        btreeVisit(tree->btree, order, visit, ctx);
+    else
+        bstVisit(tree->root, order, visit, ctx);
+}
+
+/*
+ * Persistent trees: the current version, held for the caller until it is
+ * passed to bstRelease. NULL for an empty tree or any other kind of tree.
+ */
+BSTNode* bstVersion(BST* tree) {
+    return tree->persistent ? bstRetain(tree->root) : NULL;
+}
+
+//makes version (from bstVersion, still held by the caller) the current one
+void bstSetVersion(BST* tree, BSTNode* version) {
+    if (!tree->persistent)
+        return;
+    bstRetain(version);
+    bstRelease(tree->root);
+    tree->root = version;
+}
+
+//frees the nodes under root but not their data, whatever kind they are
+static void discardNodes(BST* tree, BSTNode* root) {
+    if (tree->persistent)
+        bstRelease(root);
+    else if (tree->arena == NULL)
+        bstFree(root, NULL);
+}
+
+/*
+ * Rebuilds an empty tree from its preorder layout: data[i] is the i-th
+ * node in preorder and shape[i] holds its BST_HAS_LEFT/BST_HAS_RIGHT bits.
+ * No comparisons are made, heights are recomputed, the cost is O(count).
+ * Returns 0 if the shape does not describe a single tree, or the tree is
+ * B-tree backed and has no such layout.
+ */
+int bstRestorePreorder(BST* tree, void** data, const unsigned char* shape, int count) {
+    if (tree->root != NULL || tree->btree != NULL)
+        return 0;
+    if (count == 0)
+        return 1;
+
+    //nodes whose right subtree still has to be attached, innermost on top
+    BSTNode** pendingRight = (BSTNode**)malloc(count * sizeof(BSTNode*));
+    if (pendingRight == NULL)
+        exit(1);
+
+    int top = 0;
+    int ok = 1;
+    BSTNode* root = NULL;
+    BSTNode* leftOf = NULL;
+
+    for (int i = 0; i < count && ok; i++) {
+        BSTNode* node = createTreeNode(tree, data[i]);
+
+        if (i == 0)
+            root = node;
+        else if (leftOf != NULL)
+            leftOf->left = node;
+        else if (top > 0)
+            pendingRight[--top]->right = node;
+        else
+            ok = 0;
+
+        if (!ok) {
+            discardNodes(tree, node);
+            break;
+        }
+
+        if (shape[i] & BST_HAS_RIGHT)
+            pendingRight[top++] = node;
+        leftOf = (shape[i] & BST_HAS_LEFT) ? node : NULL;
+    }
+    free(pendingRight);
+
+    if (!ok || leftOf != NULL || top != 0) {
+        discardNodes(tree, root);
+        return 0;
+    }
+
+    //children come before parents in postorder, so heights settle in one pass
+    BSTIterator it;
+    BSTNode* node;
+    bstIterBegin(&it, root, BST_POSTORDER);
+    while ((node = bstIterNextNode(&it)) != NULL)
+        updateNode(node, tree->aggregate);
+    bstIterEnd(&it);
+
+    tree->root = root;
+    return 1;
+}
+
+//checks each element against the one before it in key order
+typedef struct {
+    BST* tree;
+    void* prev;
+    int strict;
+    int ok;
+} OrderCheck;
+
+static void orderCheckVisit(void* data, void* ctx) {
+    OrderCheck* check = (OrderCheck*)ctx;
+    if (check->prev != NULL) {
+        int cmp = check->tree->compare(check->prev, data);
+        if (cmp > 0 || (check->strict && cmp == 0))
+            check->ok = 0;
+    }
+    check->prev = data;
+}
+
+/*
+ * Checks a tree that was built without comparisons, e.g. by
+ * bstRestorePreorder from an untrusted file: the in-order elements must be
+ * increasing under compare (strictly if strict, else equal neighbours are
+ * fine, as inserts keep them), and a balanced node tree must have correct
+ * heights and sizes and satisfy AVL. Returns 1 if lookups, ranks and later
+ * inserts can rely on the tree. O(n).
+ */
+int bstCheckLayout(BST* tree, int strict) {
+    OrderCheck check = { tree, NULL, strict, 1 };
+    bstForEach(tree, BST_INORDER, orderCheckVisit, &check);
+    if (!check.ok || tree->btree != NULL || !tree->balanced)
+        return check.ok;
+
+    BSTIterator it;
+    BSTNode* node;
+    bstIterBegin(&it, tree->root, BST_POSTORDER);
+    while ((node = bstIterNextNode(&it)) != NULL) {
+        int lh = nodeHeight(node->left);
+        int rh = nodeHeight(node->right);
+        if (node->height != (lh > rh ? lh : rh) + 1 || lh - rh > 1 || rh - lh > 1
+            || node->size != nodeSize(node->left) + nodeSize(node->right) + 1) {
+            check.ok = 0;
+            break;
+        }
+    }
+    bstIterEnd(&it);
+    return check.ok;
+}
+
+//frees every node, the data (through freeData) and the tree itself
+void bstDestroy(BST* tree) {
+    if (tree == NULL)
+        return;
+
+    //B-tree copies never own anything, only the nodes go
+    if (tree->btree != NULL) {
+        btreeFree(tree->btree);
+        free(tree->total);
+        free(tree);
+        return;
+    }
+
+    //versions still held elsewhere keep their nodes, not the elements
+    if (tree->persistent) {
+        if (tree->freeData != NULL)
+            bstPostorder(tree->root, tree->freeData);
+        bstRelease(tree->root);
+        free(tree);
+        return;
+    }
+
+    //arena nodes go away with the arena, only the data may need releasing
+    if (tree->arena == NULL)
+        bstFree(tree->root, tree->freeData);
+    else if (tree->freeData != NULL)
+        bstPostorder(tree->root, tree->freeData);
+
+    free(tree);
+}
+/*
+ * Sets the aggregate kept for every node (or for the whole B-tree). Only
+ * an empty tree can take one; fails if it is not empty or too large.
+ */
+int bstUseAggregate(BST* tree, const BSTAggregate* aggregate) {
+    if (tree->root != NULL || (tree->btree != NULL && tree->btree->count > 0))
+        return 0;
+    if (aggregate != NULL && aggregate->size > BST_AGGREGATE_MAX)
+        return 0;
+    tree->aggregate = aggregate;
+    return 1;
+}
+
+//number of elements, O(1)
+int bstCount(BST* tree) {
+    return tree->btree ? tree->btree->count : nodeSize(tree->root);
+}
+
+//B-tree fallback for the order statistics: one pass over the elements in key order
+typedef struct {
+    BST* tree;
+    void* lo;
+    void* hi;
+    int index;
+    int count;
+    void* found;
+    void (*visit)(void* data, void* ctx);
+    void* ctx;
+    unsigned char* out;
+    unsigned char one[BST_AGGREGATE_MAX];
+} RangeScan;
+
+//is data inside [lo, hi), a NULL bound is open
+static int inRange(BST* tree, void* data, void* lo, void* hi) {
+    return (lo == NULL || tree->compare(data, lo) >= 0)
+        && (hi == NULL || tree->compare(data, hi) < 0);
+}
+
+static void scanVisit(void* data, void* ctx) {
+    RangeScan* scan = (RangeScan*)ctx;
+    if (scan->index++ < 0 || !inRange(scan->tree, data, scan->lo, scan->hi))
+        return;
+
+    if (scan->count == 0)
+        scan->found = data;
+    if (scan->visit != NULL)
+        scan->visit(data, scan->ctx);
+    if (scan->out != NULL) {
+        const BSTAggregate* agg = scan->tree->aggregate;
+        if (scan->count == 0) {
+            agg->init(scan->out, data);
+        }
+        else {
+            agg->init(scan->one, data);
+            agg->combine(scan->out, scan->one);
+        }
+    }
+    scan->count++;
+}
+
+static int btreeScan(BST* tree, RangeScan* scan) {
+    scan->tree = tree;
+    scan->count = 0;
+    scan->found = NULL;
+    btreeVisit(tree->btree, BST_INORDER, scanVisit, scan);
+    return scan->count;
+}
+
+//number of elements smaller than data
+int bstRank(BST* tree, void* data) {
+    if (tree->btree != NULL) {
+        RangeScan scan = { 0 };
+        scan.hi = data;
+        return btreeScan(tree, &scan);
+    }
+
+    int rank = 0;
+    BSTNode* node = tree->root;
+    while (node != NULL) {
+        if (tree->compare(data, node->data) <= 0) {
+            node = node->left;
+        }
+        else {
+            rank += nodeSize(node->left) + 1;
+            node = node->right;
+        }
+    }
+    return rank;
+}
+
+//the k-th smallest element counting from 0, NULL when k is out of range
+void* bstSelect(BST* tree, int k) {
+    if (k < 0 || k >= bstCount(tree))
+        return NULL;
+
+    if (tree->btree != NULL) {
+        //index starts at -k so only the k-th element passes
+        RangeScan scan = { 0 };
+        scan.index = -k;
+        btreeScan(tree, &scan);
+        return scan.found;
+    }
+
+    BSTNode* node = tree->root;
+    while (node != NULL) {
+        int leftSize = nodeSize(node->left);
+        if (k < leftSize) {
+            node = node->left;
+        }
+        else if (k == leftSize) {
+            return node->data;
+        }
+        else {
+            k -= leftSize + 1;
+            node = node->right;
+        }
+    }
+    return NULL;
+}
+
+//number of elements in [lo, hi)
+int bstCountRange(BST* tree, void* lo, void* hi) {
+    if (lo != NULL && hi != NULL && tree->compare(lo, hi) >= 0)
+        return 0;
+    int below = lo ? bstRank(tree, lo) : 0;
+    return (hi ? bstRank(tree, hi) : bstCount(tree)) - below;
+}
+
+/*
+ * Visits the elements of [lo, hi) in order. Subtrees entirely below lo
+ * are skipped on the way down, the walk stops at the first element >= hi.
+ */
+void bstForEachInRange(BST* tree, void* lo, void* hi, void (*visit)(void* data, void* ctx), void* ctx) {
+    if (tree->btree != NULL) {
+        RangeScan scan = { 0 };
+        scan.lo = lo;
+        scan.hi = hi;
+        scan.visit = visit;
+        scan.ctx = ctx;
+        btreeScan(tree, &scan);
+        return;
+    }
+
+    BSTIterator it;
+    bstIterBegin(&it, NULL, BST_INORDER);
+    BSTNode* node = tree->root;
+    while (node != NULL || it.top > 0) {
+        while (node != NULL) {
+            if (lo != NULL && tree->compare(node->data, lo) < 0) {
+                node = node->right;
+            }
+            else {
+                iterPush(&it, node);
+                node = node->left;
+            }
+        }
+        if (it.top == 0)
+            break;
+
+        node = it.stack[--it.top];
+        if (hi != NULL && tree->compare(node->data, hi) >= 0)
+            break;
+        visit(node->data, ctx);
+        node = node->right;
+    }
+    bstIterEnd(&it);
+}
+
+//aggregate of the whole tree in O(1), NULL when empty or none is kept
+const void* bstAggregateAll(BST* tree) {
+    if (tree->aggregate == NULL)
+        return NULL;
+    if (tree->btree != NULL)
+        return tree->total;
+    return tree->root ? nodeAggregate(tree->root) : NULL;
+}
+
+//folds the single element of node into out, which already holds something
+static void foldElement(const BSTAggregate* agg, void* out, BSTNode* node) {
+    unsigned char one[BST_AGGREGATE_MAX];
+    agg->init(one, node->data);
+    agg->combine(out, one);
+}
+
+/*
+ * Aggregate of the elements in [lo, hi), written to out. Below the node
+ * where the bounds split, each side adds whole subtrees along one path,
+ * so it costs O(height). Returns 0 (out untouched) if the range is empty.
+ */
+int bstAggregateRange(BST* tree, void* lo, void* hi, void* out) {
+    const BSTAggregate* agg = tree->aggregate;
+    if (agg == NULL)
+        return 0;
+
+    if (tree->btree != NULL) {
+        RangeScan scan = { 0 };
+        scan.lo = lo;
+        scan.hi = hi;
+        scan.out = (unsigned char*)out;
+        return btreeScan(tree, &scan) > 0;
+    }
+
+    //first node inside the range, every other one is in its subtrees
+    BSTNode* split = tree->root;
+    while (split != NULL && !inRange(tree, split->data, lo, hi))
+        split = (lo != NULL && tree->compare(split->data, lo) < 0) ? split->right : split->left;
+    if (split == NULL)
+        return 0;
+
+    agg->init(out, split->data);
+
+    //left side: nodes >= lo take their right subtree along
+    for (BSTNode* node = split->left; node != NULL; ) {
+        if (lo == NULL || tree->compare(node->data, lo) >= 0) {
+            foldElement(agg, out, node);
+            if (node->right)
+                agg->combine(out, nodeAggregate(node->right));
+            node = node->left;
+        }
+        else {
+            node = node->right;
+        }
+    }
+
+    //right side: nodes < hi take their left subtree along
+    for (BSTNode* node = split->right; node != NULL; ) {
+        if (hi == NULL || tree->compare(node->data, hi) < 0) {
+            foldElement(agg, out, node);
+            if (node->left)
+                agg->combine(out, nodeAggregate(node->left));
+            node = node->right;
+        }
+        else {
+            node = node->left;
+        }
+    }
+    return 1;
+}
+
+//perfectly balanced subtree over data[lo, hi), the middle element at the top
+static BSTNode* buildBalanced(BST* tree, void** data, int lo, int hi) {
+    if (lo >= hi)
+        return NULL;
+
+    int mid = lo + (hi - lo) / 2;
+    BSTNode* node = createTreeNode(tree, data[mid]);
+    node->left = buildBalanced(tree, data, lo, mid);
+    node->right = buildBalanced(tree, data, mid + 1, hi);
+    updateNode(node, tree->aggregate);
+    return node;
+}
+
+//same shape as buildBalanced, but relinks existing nodes instead of allocating
+static BSTNode* linkBalanced(BSTNode** nodes, int lo, int hi, const BSTAggregate* agg) {
+    if (lo >= hi)
+        return NULL;
+
+    int mid = lo + (hi - lo) / 2;
+    BSTNode* node = nodes[mid];
+    node->left = linkBalanced(nodes, lo, mid, agg);
+    node->right = linkBalanced(nodes, mid + 1, hi, agg);
+    updateNode(node, agg);
+    return node;
+}
+
+/*
+ * Fills an empty tree from count elements already in compare order (equal
+ * ones in the order later inserts would keep them) in O(count). Node trees
+ * come out perfectly balanced, which also satisfies AVL. A B-tree backed
+ * tree copies the elements and hands the originals to freeData, as bstAdd
+ * does. Returns 0 if the tree is not empty or data is not sorted.
+ */
+int bstBuildSorted(BST* tree, void** data, int count) {
+    if (bstCount(tree) != 0)
+        return 0;
+    for (int i = 1; i < count; i++)
+        if (tree->compare(data[i - 1], data[i]) > 0)
+            return 0;
+
+    if (tree->btree != NULL) {
+        btreeBuildSorted(tree->btree, data, count);
+        for (int i = 0; i < count; i++) {
+            if (tree->aggregate != NULL)
+                foldTotal(tree, data[i]);
+            if (tree->freeData != NULL)
+                tree->freeData(data[i]);
+        }
+        return 1;
+    }
+
+    tree->root = buildBalanced(tree, data, 0, count);
+    return 1;
+}
+
+//appends every visited pointer to an array
+typedef struct {
+    void** items;
+    int count;
+} Collect;
+
+static void collectVisit(void* data, void* ctx) {
+    Collect* c = (Collect*)ctx;
+    c->items[c->count++] = data;
+}
+
+/*
+ * Stable merge of two sorted runs: on ties a comes first, as if every
+ * element of b had been inserted after those of a. The runs hold elements,
+ * or nodes when nodes is set.
+ */
+static void mergeRuns(BST* tree, void** a, int na, void** b, int nb, void** out, int nodes) {
+    int i = 0, j = 0, k = 0;
+    while (i < na && j < nb) {
+        void* x = nodes ? ((BSTNode*)a[i])->data : a[i];
+        void* y = nodes ? ((BSTNode*)b[j])->data : b[j];
+        out[k++] = tree->compare(x, y) <= 0 ? a[i++] : b[j++];
+    }
+    while (i < na)
+        out[k++] = a[i++];
+    while (j < nb)
+        out[k++] = b[j++];
+}
+
+static void** allocPointers(int count) {
+    void** p = (void**)malloc((count > 0 ? count : 1) * sizeof(void*));
+    if (p == NULL)
+        exit(1);
+    return p;
+}
+
+//persistent trees share their nodes with old versions, so the result gets new ones
+static void mergeVersions(BST* into, BST* from) {
+    int na = bstCount(into), nb = bstCount(from);
+    void** elems = allocPointers(2 * (na + nb));
+    void** merged = elems + na + nb;
+
+    Collect c = { elems, 0 };
+    bstVisit(into->root, BST_INORDER, collectVisit, &c);
+    bstVisit(from->root, BST_INORDER, collectVisit, &c);
+    mergeRuns(into, elems, na, elems + na, nb, merged, 0);
+
+    BSTNode* root = buildBalanced(into, merged, 0, na + nb);
+    discardNodes(into, into->root);
+    discardNodes(from, from->root);
+    into->root = root;
+    from->root = NULL;
+    free(elems);
+}
+
+//node trees: flattens both into node arrays, merges them and relinks the nodes
+static void mergeNodeTrees(BST* into, BST* from) {
+    int na = bstCount(into), nb = bstCount(from);
+    void** nodes = allocPointers(2 * (na + nb));
+    void** merged = nodes + na + nb;
+
+    BSTIterator it;
+    BSTNode* node;
+    int n = 0;
+    bstIterBegin(&it, into->root, BST_INORDER);
+    while ((node = bstIterNextNode(&it)) != NULL)
+        nodes[n++] = node;
+    bstIterEnd(&it);
+
+    //nodes from another allocator or without room for the aggregate are replaced
+    int reuse = from->arena == into->arena && from->aggregate == into->aggregate;
+    bstIterBegin(&it, from->root, BST_INORDER);
+    while ((node = bstIterNextNode(&it)) != NULL) {
+        if (reuse) {
+            nodes[n++] = node;
+            continue;
+        }
+        nodes[n++] = createNode(node->data, into->arena, into->aggregate);
+    }
+    bstIterEnd(&it);
+    if (!reuse && from->arena == NULL)
+        bstFree(from->root, NULL);
+
+    mergeRuns(into, nodes, na, nodes + na, nb, merged, 1);
+    into->root = linkBalanced((BSTNode**)merged, 0, na + nb, into->aggregate);
+    from->root = NULL;
+    free(nodes);
+}
+
+//B-tree target: merges the element pointers and bulk builds a fresh B-tree
+static void mergeIntoBTree(BST* into, BST* from) {
+    int na = bstCount(into), nb = bstCount(from);
+    void** elems = allocPointers(2 * (na + nb));
+    void** merged = elems + na + nb;
+
+    Collect c = { elems, 0 };
+    bstForEach(into, BST_INORDER, collectVisit, &c);
+    bstForEach(from, BST_INORDER, collectVisit, &c);
+    mergeRuns(into, elems, na, elems + na, nb, merged, 0);
+
+    //the old trees still hold the elements while they are copied
+    BTree* old = into->btree;
+    into->btree = createBTree(old->elemSize, into->compare);
+    btreeUseArena(into->btree, old->arena);
+    btreeBuildSorted(into->btree, merged, na + nb);
+
+    free(into->total);
+    into->total = NULL;
+    if (into->aggregate != NULL)
+        for (int i = 0; i < na + nb; i++)
+            foldTotal(into, merged[i]);
+
+    btreeFree(old);
+    if (from->btree != NULL) {
+        old = from->btree;
+        from->btree = createBTree(old->elemSize, from->compare);
+        btreeUseArena(from->btree, old->arena);
+        btreeFree(old);
+        free(from->total);
+        from->total = NULL;
+    }
+    else {
+        //the originals were copied, like bstAdd into a B-tree they go to freeData
+        if (from->arena == NULL)
+            bstFree(from->root, from->freeData);
+        else if (from->freeData != NULL)
+            bstPostorder(from->root, from->freeData);
+        from->root = NULL;
+    }
+    free(elems);
+}
+
+/*
+ * Moves every element of from into into in O(n + m): both are flattened
+ * in order, merged (into's elements first among equals) and rebuilt
+ * perfectly balanced. from is left empty but still has to be destroyed.
+ * Persistent trees get new nodes instead, old versions keep theirs.
+ * Both trees must use the same compare, and a node tree cannot take the
+ * elements of a B-tree (they live inside its nodes). Returns 0 otherwise.
+ */
+int bstMerge(BST* into, BST* from) {
+    if (into == from || into->compare != from->compare)
+        return 0;
+    if (into->btree == NULL && from->btree != NULL)
+        return 0;
+    if (bstCount(from) == 0)
+        return 1;
+
+    if (into->btree != NULL)
+        mergeIntoBTree(into, from);
+    else if (into->persistent || from->persistent)
+        mergeVersions(into, from);
+    else
+        mergeNodeTrees(into, from);
+    return 1;
+}
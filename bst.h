@@ -1,26 +1,124 @@
 #ifndef BST_H
 #define BST_H
 
+#include "arena.h"
+
 typedef struct BSTNode {
     void* data;
     struct BSTNode* left;
     struct BSTNode* right;
+    int height;     // only maintained by the balanced (AVL) insert
+    int size;       // nodes in this subtree, for rank and select
 } BSTNode;
 
+#define BST_AGGREGATE_MAX 64    // bytes, so range queries can fold on the stack
+
+/*
+ * Optional per-node summary of a subtree, e.g. the best value per type.
+ * It is stored right behind each node and kept up to date on insert.
+ * combine must be associative and commutative: plain inserts fold the new
+ * element into every ancestor, rotations rebuild from the children.
+ */
+typedef struct {
+    size_t size;                                    // at most BST_AGGREGATE_MAX
+    void (*init)(void* agg, void* data);            // summary of one element
+    void (*combine)(void* agg, const void* other);  // folds other into agg
+} BSTAggregate;
+
+struct BTree;
+
 typedef struct {
     BSTNode* root;
     int (*compare)(void*, void*);
     void (*print)(void*);
     void (*freeData)(void*);
+    int balanced;
+    int persistent;         // nodes are shared between versions, see createPersistentBST
+    Arena* arena;   // when set, nodes are carved from it and never freed one by one
+    struct BTree* btree;    // B-tree backend: elements are copied into it, root stays NULL
+    const BSTAggregate* aggregate;
+    void* total;            // B-tree backend: aggregate of every element
 } BST;
 
+typedef enum { BST_PREORDER, BST_INORDER, BST_POSTORDER } BSTOrder;
+
+// Shape bits of a node, used to store and restore a tree's exact layout
+#define BST_HAS_LEFT  1
+#define BST_HAS_RIGHT 2
+
+#define BST_ITER_INLINE_DEPTH 48
+
+/*
+ * Explicit stack iterator over any of the three orders.
+ * The stack starts inline and only moves to the heap on very deep trees.
+ * Stored data must not be NULL, NULL marks the end of the traversal.
+ */
+typedef struct {
+    BSTNode** stack;
+    int top;
+    int capacity;
+    BSTOrder order;
+    BSTNode* current;       // inorder/postorder: next subtree to descend
+    BSTNode* lastVisited;   // postorder: last node returned
+    BSTNode* inlineStack[BST_ITER_INLINE_DEPTH];
+} BSTIterator;
+
 BST* createBST(int (*cmp)(void*, void*), void (*print)(void*), void (*freeData)(void*));
+BST* createBalancedBST(int (*cmp)(void*, void*), void (*print)(void*), void (*freeData)(void*));
+BST* createBTreeBST(size_t elemSize, int (*cmp)(void*, void*), void (*print)(void*), void (*freeData)(void*));
+BST* createPersistentBST(int (*cmp)(void*, void*), void (*print)(void*), void (*freeData)(void*));
 BSTNode* bstInsert(BSTNode* root, void* data, int (*cmp)(void*, void*));
+BSTNode* bstInsertBalanced(BSTNode* root, void* data, int (*cmp)(void*, void*));
 void* bstFind(BSTNode* root, void* data, int (*cmp)(void*, void*));
 void bstInorder(BSTNode* root, void (*print)(void*));
 void bstPreorder(BSTNode* root, void (*print)(void*));
 void bstPostorder(BSTNode* root, void (*print)(void*));
 void bstFree(BSTNode* root, void (*freeData)(void*));
-static BSTNode* createNode(void* data);
+
+void bstIterBegin(BSTIterator* it, BSTNode* root, BSTOrder order);
+void* bstIterNext(BSTIterator* it);
+BSTNode* bstIterNextNode(BSTIterator* it);
+void bstIterEnd(BSTIterator* it);
+void bstVisit(BSTNode* root, BSTOrder order, void (*visit)(void* data, void* ctx), void* ctx);
+
+/*
+ * Persistent (copy-on-write) AVL trees. A version is just a root: it is
+ * read with bstFind, bstVisit and the iterators like any other root, and is
+ * never modified. bstInsertPersistent returns a new version that copies the
+ * O(log n) nodes on the insert path and shares every other node with the
+ * old one. Nodes are reference counted, so each version handed out must be
+ * released once. Only roots built by these functions may be passed in.
+ */
+BSTNode* bstInsertPersistent(BSTNode* root, void* data, int (*cmp)(void*, void*));
+BSTNode* bstRetain(BSTNode* root);
+void bstRelease(BSTNode* root);
+
+// Tree level helpers, they use the callbacks and mode stored in the BST
+void bstUseArena(BST* tree, Arena* arena);
+void* bstAdd(BST* tree, void* data);
+void* bstLookup(BST* tree, void* data);
+void bstForEach(BST* tree, BSTOrder order, void (*visit)(void* data, void* ctx), void* ctx);
+int bstRestorePreorder(BST* tree, void** data, const unsigned char* shape, int count);
+int bstBuildSorted(BST* tree, void** data, int count);
+int bstCheckLayout(BST* tree, int strict);
+int bstMerge(BST* into, BST* from);
+BSTNode* bstVersion(BST* tree);
+void bstSetVersion(BST* tree, BSTNode* version);
+void bstDestroy(BST* tree);
+
+/*
+ * Order statistics in O(height), so O(log n) on AVL trees. Ranges are
+ * [lo, hi) under the tree's compare, a NULL bound is open. Count and the
+ * whole-tree aggregate are O(1). The B-tree backend keeps no subtree
+ * sizes, so its rank, select and range queries walk the elements.
+ */
+int bstUseAggregate(BST* tree, const BSTAggregate* aggregate);
+int bstCount(BST* tree);
+int bstRank(BST* tree, void* data);
+void* bstSelect(BST* tree, int k);
+int bstCountRange(BST* tree, void* lo, void* hi);
+void bstForEachInRange(BST* tree, void* lo, void* hi, void (*visit)(void* data, void* ctx), void* ctx);
+const void* bstAggregateAll(BST* tree);
+int bstAggregateRange(BST* tree, void* lo, void* hi, void* out);
 
 #endif
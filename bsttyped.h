@@ -0,0 +1,205 @@
+#ifndef BSTTYPED_H
+#define BSTTYPED_H
+
+#include <stdlib.h>
+#include "arena.h"
+#include "bst.h"
+
+/*
+ * Type-specialized AVL trees: the same operations as the BST handle, but the
+ * key is stored by value in the node and the comparison is a function the
+ * compiler can inline instead of a void* callback.
+ *
+ *   BST_TYPED_DECLARE(ItemTree, itemTree, Item)            in a header
+ *   BST_TYPED_DEFINE(ItemTree, itemTree, Item, itemOrder)  in one .c file
+ *
+ * gives ItemTree, ItemTreeNode and itemTreeCreate, itemTreeUseArena,
+ * itemTreeAdd, itemTreeLookup, itemTreeForEach and itemTreeDestroy.
+ * compare(const Type*, const Type*) must be visible (ideally static inline)
+ * where the tree is defined. Equal keys go right, as in bstAdd.
+ */
+
+//AVL height bound for any tree that fits in memory, sizes the traversal stack
+#define BST_TYPED_MAX_HEIGHT 96
+
+#define BST_TYPED_DECLARE(Tree, prefix, Type)                                       \
+    typedef struct Tree##Node {                                                     \
+        Type key;                                                                   \
+        struct Tree##Node* left;                                                    \
+        struct Tree##Node* right;                                                   \
+        int height;                                                                 \
+    } Tree##Node;                                                                   \
+                                                                                    \
+    typedef struct {                                                                \
+        Tree##Node* root;                                                           \
+        int count;                                                                  \
+        Arena* arena;   /* optional, nodes are then never freed one by one */       \
+    } Tree;                                                                         \
+                                                                                    \
+    Tree* prefix##Create(void);                                                     \
+    void prefix##UseArena(Tree* tree, Arena* arena);                                \
+    Type* prefix##Add(Tree* tree, const Type* key);                                 \
+    Type* prefix##Lookup(const Tree* tree, const Type* key);                        \
+    void prefix##ForEach(const Tree* tree, BSTOrder order,                          \
+        void (*visit)(const Type* key, void* ctx), void* ctx);                      \
+    void prefix##Destroy(Tree* tree);
+
+#define BST_TYPED_DEFINE(Tree, prefix, Type, compare)                               \
+    static int prefix##Height(const Tree##Node* node) {                             \
+        return node ? node->height : 0;                                             \
+    }                                                                               \
+                                                                                    \
+    static void prefix##UpdateHeight(Tree##Node* node) {                            \
+        int lh = prefix##Height(node->left);                                        \
+        int rh = prefix##Height(node->right);                                       \
+        node->height = (lh > rh ? lh : rh) + 1;                                     \
+    }                                                                               \
+                                                                                    \
+    static Tree##Node* prefix##RotateRight(Tree##Node* node) {                      \
+        Tree##Node* pivot = node->left;                                             \
+        node->left = pivot->right;                                                  \
+        pivot->right = node;                                                        \
+        prefix##UpdateHeight(node);                                                 \
+        prefix##UpdateHeight(pivot);                                                \
+        return pivot;                                                               \
+    }                                                                               \
+                                                                                    \
+    static Tree##Node* prefix##RotateLeft(Tree##Node* node) {                       \
+        Tree##Node* pivot = node->right;                                            \
+        node->right = pivot->left;                                                  \
+        pivot->left = node;                                                         \
+        prefix##UpdateHeight(node);                                                 \
+        prefix##UpdateHeight(pivot);                                                \
+        return pivot;                                                               \
+    }                                                                               \
+                                                                                    \
+    static Tree##Node* prefix##Rebalance(Tree##Node* node) {                        \
+        prefix##UpdateHeight(node);                                                 \
+        int balance = prefix##Height(node->left) - prefix##Height(node->right);     \
+        if (balance > 1) {                                                          \
+            if (prefix##Height(node->left->left) < prefix##Height(node->left->right)) \
+                node->left = prefix##RotateLeft(node->left);                        \
+            return prefix##RotateRight(node);                                       \
+        }                                                                           \
+        if (balance < -1) {                                                         \
+            if (prefix##Height(node->right->right) < prefix##Height(node->right->left)) \
+                node->right = prefix##RotateRight(node->right);                     \
+            return prefix##RotateLeft(node);                                        \
+        }                                                                           \
+        return node;                                                                \
+    }                                                                               \
+                                                                                    \
+    Tree* prefix##Create(void) {                                                    \
+        Tree* tree = (Tree*)calloc(1, sizeof(Tree));                                \
+        if (tree == NULL)                                                           \
+            exit(1);                                                                \
+        return tree;                                                                \
+    }                                                                               \
+                                                                                    \
+    void prefix##UseArena(Tree* tree, Arena* arena) {                               \
+        tree->arena = arena;                                                        \
+    }                                                                               \
+                                                                                    \
+    /* iterative descent, then the path is rebalanced bottom up */                  \
+    Type* prefix##Add(Tree* tree, const Type* key) {                                \
+        Tree##Node** path[BST_TYPED_MAX_HEIGHT];                                    \
+        int depth = 0;                                                              \
+        Tree##Node** link = &tree->root;                                            \
+        while (*link != NULL) {                                                     \
+            path[depth++] = link;                                                   \
+            link = compare(key, &(*link)->key) < 0 ? &(*link)->left : &(*link)->right; \
+        }                                                                           \
+                                                                                    \
+        Tree##Node* node = tree->arena                                              \
+            ? (Tree##Node*)arenaAlloc(tree->arena, sizeof(Tree##Node))              \
+            : (Tree##Node*)malloc(sizeof(Tree##Node));                              \
+        if (node == NULL)                                                           \
+            exit(1);                                                                \
+        node->key = *key;                                                           \
+        node->left = NULL;                                                          \
+        node->right = NULL;                                                         \
+        node->height = 1;                                                           \
+        *link = node;                                                               \
+        tree->count++;                                                              \
+                                                                                    \
+        while (depth > 0) {                                                         \
+            Tree##Node** at = path[--depth];                                        \
+            int before = (*at)->height;                                             \
+            *at = prefix##Rebalance(*at);                                           \
+            if ((*at)->height == before)                                            \
+                break;                                                              \
+        }                                                                           \
+        return &node->key;                                                          \
+    }                                                                               \
+                                                                                    \
+    Type* prefix##Lookup(const Tree* tree, const Type* key) {                       \
+        Tree##Node* node = tree->root;                                              \
+        while (node != NULL) {                                                      \
+            int res = compare(key, &node->key);                                     \
+            if (res == 0)                                                           \
+                return &node->key;                                                  \
+            node = res < 0 ? node->left : node->right;                              \
+        }                                                                           \
+        return NULL;                                                                \
+    }                                                                               \
+                                                                                    \
+    void prefix##ForEach(const Tree* tree, BSTOrder order,                          \
+        void (*visit)(const Type* key, void* ctx), void* ctx) {                     \
+        Tree##Node* stack[BST_TYPED_MAX_HEIGHT];                                    \
+        int top = 0;                                                                \
+        Tree##Node* node = tree->root;                                              \
+        Tree##Node* last = NULL;                                                    \
+        if (order == BST_PREORDER) {                                                \
+            if (node != NULL)                                                       \
+                stack[top++] = node;                                                \
+            while (top > 0) {                                                       \
+                node = stack[--top];                                                \
+                visit(&node->key, ctx);                                             \
+                if (node->right) stack[top++] = node->right;                        \
+                if (node->left) stack[top++] = node->left;                          \
+            }                                                                       \
+            return;                                                                 \
+        }                                                                           \
+        while (node != NULL || top > 0) {                                           \
+            while (node != NULL) {                                                  \
+                stack[top++] = node;                                                \
+                node = node->left;                                                  \
+            }                                                                       \
+            Tree##Node* peek = stack[top - 1];                                      \
+            if (order == BST_INORDER) {                                             \
+                top--;                                                              \
+                visit(&peek->key, ctx);                                             \
+                node = peek->right;                                                 \
+            }                                                                       \
+            else if (peek->right != NULL && peek->right != last) {                  \
+                node = peek->right;                                                 \
+            }                                                                       \
+            else {                                                                  \
+                top--;                                                              \
+                visit(&peek->key, ctx);                                             \
+                last = peek;                                                        \
+            }                                                                       \
+        }                                                                           \
+    }                                                                               \
+                                                                                    \
+    /* rotation free as in bstFree, O(1) extra space */                             \
+    void prefix##Destroy(Tree* tree) {                                              \
+        if (tree == NULL)                                                           \
+            return;                                                                 \
+        Tree##Node* node = tree->arena ? NULL : tree->root;                         \
+        while (node != NULL) {                                                      \
+            if (node->left != NULL) {                                               \
+                Tree##Node* leftNode = node->left;                                  \
+                node->left = leftNode->right;                                       \
+                leftNode->right = node;                                             \
+                node = leftNode;                                                    \
+                continue;                                                           \
+            }                                                                       \
+            Tree##Node* next = node->right;                                         \
+            free(node);                                                             \
+            node = next;                                                            \
+        }                                                                           \
+        free(tree);                                                                 \
+    }
+
+#endif
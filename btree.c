@@ -0,0 +1,291 @@
+#include <stdlib.h>
+#include <string.h>
+#include "btree.h"
+#include "prof.h"
+
+typedef struct {
+    BTreeNode* node;
+    int child;              // next child to descend into
+} BTreeFrame;
+
+static unsigned char* keyAt(BTree* tree, BTreeNode* node, int i) {
+    return node->slots + (size_t)i * tree->stride;
+}
+
+static BTreeNode** childrenOf(BTree* tree, BTreeNode* node) {
+    return (BTreeNode**)(node->slots + (size_t)tree->maxKeys * tree->stride);
+}
+
+static BTreeNode* createBTreeNode(BTree* tree, int leaf) {
+    size_t size = sizeof(BTreeNode) + (size_t)tree->maxKeys * tree->stride;
+    if (!leaf)
+        size += (size_t)(tree->maxKeys + 1) * sizeof(BTreeNode*);
+
+    BTreeNode* node = tree->arena ? (BTreeNode*)arenaAlloc(tree->arena, size)
+                                  : (BTreeNode*)malloc(size);
+    if (node == NULL)
+        exit(1);
+    node->count = 0;
+    node->leaf = leaf;
+    return node;
+}
+
+/*
+ * Creates an empty tree for elements of elemSize bytes. The node width is
+ * picked so the elements fill about BTREE_KEY_BYTES, with at least 3 per node.
+ */
+BTree* createBTree(size_t elemSize, int (*cmp)(void*, void*)) {
+    BTree* tree = (BTree*)malloc(sizeof(BTree));
+    if (tree == NULL)
+        exit(1);
+
+    tree->root = NULL;
+    tree->elemSize = elemSize;
+    tree->stride = (elemSize + 7) & ~(size_t)7;
+    if (tree->stride == 0)
+        tree->stride = 8;
+    int fit = (int)(BTREE_KEY_BYTES / tree->stride);
+    tree->maxKeys = fit < 3 ? 3 : (fit % 2 ? fit : fit - 1);
+    tree->count = 0;
+    tree->compare = cmp;
+    tree->arena = NULL;
+    return tree;
+}
+
+//makes all future nodes of an empty tree come from the arena
+void btreeUseArena(BTree* tree, Arena* arena) {
+    tree->arena = arena;
+}
+
+//first position whose element is greater than data, so equal ones stay in front
+static int upperBound(BTree* tree, BTreeNode* node, void* data) {
+    int lo = 0, hi = node->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (tree->compare(data, keyAt(tree, node, mid)) < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+/*
+ * Splits the full child i of parent: the upper half moves to a new node and
+ * the median moves up into parent, which must have room for it.
+ */
+static void splitChild(BTree* tree, BTreeNode* parent, int i) {
+    BTreeNode* full = childrenOf(tree, parent)[i];
+    BTreeNode* right = createBTreeNode(tree, full->leaf);
+    int half = tree->maxKeys / 2;
+
+    right->count = half;
+    memcpy(keyAt(tree, right, 0), keyAt(tree, full, half + 1), (size_t)half * tree->stride);
+    if (!full->leaf)
+        memcpy(childrenOf(tree, right), childrenOf(tree, full) + half + 1,
+            (size_t)(half + 1) * sizeof(BTreeNode*));
+    full->count = half;
+
+    BTreeNode** children = childrenOf(tree, parent);
+    memmove(children + i + 2, children + i + 1, (size_t)(parent->count - i) * sizeof(BTreeNode*));
+    children[i + 1] = right;
+    memmove(keyAt(tree, parent, i + 1), keyAt(tree, parent, i),
+        (size_t)(parent->count - i) * tree->stride);
+    memcpy(keyAt(tree, parent, i), keyAt(tree, full, half), tree->stride);
+    parent->count++;
+}
+
+/*
+ * Copies data into the tree and returns the stored copy. Full nodes are
+ * split on the way down, so the insert never has to walk back up.
+ */
+void* btreeInsert(BTree* tree, const void* data) {
+    if (tree->root == NULL)
+        tree->root = createBTreeNode(tree, 1);
+
+    if (tree->root->count == tree->maxKeys) {
+        BTreeNode* newRoot = createBTreeNode(tree, 0);
+        childrenOf(tree, newRoot)[0] = tree->root;
+        tree->root = newRoot;
+        splitChild(tree, newRoot, 0);
+    }
+
+    BTreeNode* node = tree->root;
+    while (!node->leaf) {
+        int i = upperBound(tree, node, (void*)data);
+        if (childrenOf(tree, node)[i]->count == tree->maxKeys) {
+            splitChild(tree, node, i);
+            if (tree->compare((void*)data, keyAt(tree, node, i)) >= 0)
+                i++;
+        }
+        node = childrenOf(tree, node)[i];
+    }
+
+    int i = upperBound(tree, node, (void*)data);
+    memmove(keyAt(tree, node, i + 1), keyAt(tree, node, i), (size_t)(node->count - i) * tree->stride);
+    memcpy(keyAt(tree, node, i), data, tree->elemSize);
+    node->count++;
+    tree->count++;
+    return keyAt(tree, node, i);
+}
+
+//returns a stored element equal to data, or NULL
+void* btreeFind(BTree* tree, void* data) {
+    BTreeNode* node = tree->root;
+
+    while (node != NULL) {
+        //first element not below data, an equal one is either here or to its left
+        int lo = 0, hi = node->count;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (tree->compare(data, keyAt(tree, node, mid)) > 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo < node->count && tree->compare(data, keyAt(tree, node, lo)) == 0)
+            return keyAt(tree, node, lo);
+        node = node->leaf ? NULL : childrenOf(tree, node)[lo];
+    }
+
+    return NULL;
+}
+
+static void visitKeys(BTree* tree, BTreeNode* node, void (*visit)(void* data, void* ctx), void* ctx) {
+    for (int i = 0; i < node->count; i++)
+        visit(keyAt(tree, node, i), ctx);
+}
+
+/*
+ * Visits every element without recursion. Inorder is key order; preorder
+ * lists a node's elements before its subtrees, postorder after them.
+ */
+void btreeVisit(BTree* tree, BSTOrder order, void (*visit)(void* data, void* ctx), void* ctx) {
+    BTreeFrame stack[BTREE_MAX_HEIGHT];
+    int top = 0;
+
+    if (tree->root == NULL)
+        return;
+    stack[top].node = tree->root;
+    stack[top++].child = 0;
+    if (order == BST_PREORDER)
+        visitKeys(tree, tree->root, visit, ctx);
+
+    while (top > 0) {
+        BTreeFrame* frame = &stack[top - 1];
+        BTreeNode* node = frame->node;
+
+        if (node->leaf) {
+            if (order != BST_PREORDER)
+                visitKeys(tree, node, visit, ctx);
+            top--;
+            continue;
+        }
+        if (frame->child > node->count) {
+            if (order == BST_POSTORDER)
+                visitKeys(tree, node, visit, ctx);
+            top--;
+            continue;
+        }
+
+        //inorder: the element between two subtrees comes after the left one
+        if (order == BST_INORDER && frame->child > 0)
+            visit(keyAt(tree, node, frame->child - 1), ctx);
+
+        BTreeNode* child = childrenOf(tree, node)[frame->child++];
+        stack[top].node = child;
+        stack[top++].child = 0;
+        if (order == BST_PREORDER)
+            visitKeys(tree, child, visit, ctx);
+    }
+}
+
+//frees every node and the tree itself, arena nodes go away with the arena
+void btreeFree(BTree* tree) {
+    if (tree == NULL)
+        return;
+
+    BTreeFrame stack[BTREE_MAX_HEIGHT];
+    int top = 0;
+    if (tree->root != NULL && tree->arena == NULL) {
+        stack[top].node = tree->root;
+        stack[top++].child = 0;
+    }
+
+    while (top > 0) {
+        BTreeFrame* frame = &stack[top - 1];
+        BTreeNode* node = frame->node;
+        if (node->leaf || frame->child > node->count) {
+            free(node);
+            top--;
+            continue;
+        }
+        stack[top].node = childrenOf(tree, node)[frame->child++];
+        stack[top++].child = 0;
+    }
+
+    free(tree);
+}
+
+/*
+ * Builds the subtree of height levels holding the n sorted elements of
+ * data. The children share the elements evenly, and the number of
+ * children is the smallest that fits, so every node ends up at least
+ * half full.
+ */
+static BTreeNode* buildLevel(BTree* tree, void** data, int n, int height, const long long* capacity) {
+    BTreeNode* node = createBTreeNode(tree, height == 1);
+    if (height == 1) {
+        for (int i = 0; i < n; i++)
+            memcpy(keyAt(tree, node, i), data[i], tree->elemSize);
+        node->count = n;
+        return node;
+    }
+
+    long long below = capacity[height - 1];
+    int childCount = (int)((n + below + 1) / (below + 1));
+    if (childCount < 2)
+        childCount = 2;
+    int rest = n - (childCount - 1);
+    int each = rest / childCount;
+    int extra = rest % childCount;
+
+    int at = 0;
+    for (int c = 0; c < childCount; c++) {
+        int size = each + (c < extra);
+        childrenOf(tree, node)[c] = buildLevel(tree, data + at, size, height - 1, capacity);
+        at += size;
+        if (c < childCount - 1)
+            memcpy(keyAt(tree, node, c), data[at++], tree->elemSize);
+    }
+    node->count = childCount - 1;
+    return node;
+}
+
+/*
+ * Fills an empty tree from count elements already in compare order, in
+ * O(count) and without a single comparison. All leaves end up at the same
+ * depth. Returns 0 if the tree is not empty.
+ */
+int btreeBuildSorted(BTree* tree, void** data, int count) {
+    if (tree->root != NULL && tree->root->count > 0)
+        return 0;
+    if (count <= 0)
+        return 1;
+
+    //capacity[h]: elements a full tree of height h holds
+    long long capacity[BTREE_MAX_HEIGHT];
+    int height = 1;
+    capacity[0] = 0;
+    capacity[1] = tree->maxKeys;
+    while (capacity[height] < count) {
+        capacity[height + 1] = capacity[height] * (tree->maxKeys + 1) + tree->maxKeys;
+        height++;
+    }
+
+    if (tree->root != NULL && tree->arena == NULL)
+        free(tree->root);
+    tree->root = buildLevel(tree, data, count, height, capacity);
+    tree->count = count;
+    return 1;
+}
@@ -0,0 +1,47 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <stddef.h>
+#include "arena.h"
+#include "bst.h"
+
+#define BTREE_KEY_BYTES 256     // element area of one node, four cache lines
+#define BTREE_MAX_HEIGHT 64     // traversal stack, far above any reachable height
+
+/*
+ * One node: count elements stored inline, stride bytes apart, followed on
+ * internal nodes by count + 1 child pointers. Leaves skip the child array.
+ */
+typedef struct BTreeNode {
+    int count;
+    int leaf;
+    unsigned char slots[];
+} BTreeNode;
+
+/*
+ * B-tree of fixed size elements copied into wide nodes, so a search touches
+ * a handful of nodes instead of one node per level. Equal elements are kept
+ * in insertion order, like the right-leaning BST. Elements need at most
+ * 8-byte alignment and must not own memory: the tree only ever frees nodes.
+ * Pointers handed out by insert, find and visit stay valid until the next
+ * insert, which may move elements between nodes.
+ */
+typedef struct BTree {
+    BTreeNode* root;
+    size_t elemSize;
+    size_t stride;          // elemSize rounded up to 8 bytes
+    int maxKeys;            // odd, so a full node splits around its median
+    int count;
+    int (*compare)(void*, void*);
+    Arena* arena;           // when set, nodes are carved from it and never freed one by one
+} BTree;
+
+BTree* createBTree(size_t elemSize, int (*cmp)(void*, void*));
+void btreeUseArena(BTree* tree, Arena* arena);
+void* btreeInsert(BTree* tree, const void* data);
+void* btreeFind(BTree* tree, void* data);
+int btreeBuildSorted(BTree* tree, void** data, int count);
+void btreeVisit(BTree* tree, BSTOrder order, void (*visit)(void* data, void* ctx), void* ctx);
+void btreeFree(BTree* tree);
+
+#endif
@@ -0,0 +1,207 @@
+#include <stdlib.h>
+#include <string.h>
+#include "checkpoint.h"
+#include "prof.h"
+
+//doubles a journal array so appending stays amortized O(1)
+static void* growArray(void* array, int* capacity, size_t elemSize) {
+    int newCapacity = *capacity ? *capacity * 2 : 16;
+    void* newArray = realloc(array, (size_t)newCapacity * elemSize);
+    if (newArray == NULL)
+        exit(1);
+    *capacity = newCapacity;
+    return newArray;
+}
+
+/*
+ * Turns checkpoints on. Must come before the player is created, so the bag
+ * and monster log are made persistent. Returns 0 with the B-tree backend
+ * or once a player exists; calling it again is harmless.
+ */
+int checkpointEnable(GameState* g) {
+    if (g->history != NULL)
+        return 1;
+    if (g->useBTree || g->player != NULL)
+        return 0;
+
+    g->history = (CheckpointLog*)calloc(1, sizeof(CheckpointLog));
+    if (g->history == NULL)
+        exit(1);
+    return 1;
+}
+
+/*
+ * Remembers the current state and returns its checkpoint number, or -1 if
+ * checkpoints are not enabled or there is no player yet. Numbers count up
+ * from 0 and stay valid until an earlier checkpoint is restored.
+ */
+int gameCheckpoint(GameState* g) {
+    CheckpointLog* log = g->history;
+    if (log == NULL || g->player == NULL)
+        return -1;
+
+    if (log->count == log->capacity)
+        log->checkpoints = (Checkpoint*)growArray(log->checkpoints, &log->capacity, sizeof(Checkpoint));
+
+    Checkpoint* cp = &log->checkpoints[log->count];
+    cp->roomMark = log->roomCount;
+    cp->createdMark = log->createdCount;
+    cp->unvisitedRooms = g->unvisitedRooms;
+    cp->monstersRemaining = g->monstersRemaining;
+    cp->serial = ++log->nextSerial;
+    cp->playerSaved = 0;
+    return log->count++;
+}
+
+//saves a room's contents the first time it changes after the last checkpoint
+void checkpointTouchRoom(GameState* g, Room* room) {
+    CheckpointLog* log = g->history;
+    if (log->count == 0)
+        return;
+
+    int serial = log->checkpoints[log->count - 1].serial;
+    if (room->id >= log->stampCapacity) {
+        int oldCapacity = log->stampCapacity;
+        while (room->id >= log->stampCapacity)
+            log->roomStamp = (int*)growArray(log->roomStamp, &log->stampCapacity, sizeof(int));
+        memset(log->roomStamp + oldCapacity, 0, (size_t)(log->stampCapacity - oldCapacity) * sizeof(int));
+    }
+    if (log->roomStamp[room->id] == serial)
+        return;
+    log->roomStamp[room->id] = serial;
+
+    if (log->roomCount == log->roomCapacity)
+        log->rooms = (RoomUndo*)growArray(log->rooms, &log->roomCapacity, sizeof(RoomUndo));
+
+    RoomUndo* undo = &log->rooms[log->roomCount++];
+    undo->room = room;
+    undo->monster = room->monster;
+    undo->item = room->item;
+    undo->visited = room->visited;
+    undo->monsterHp = room->monster ? room->monster->hp : 0;
+}
+
+//saves the player the first time it changes after the last checkpoint
+void checkpointTouchPlayer(GameState* g) {
+    CheckpointLog* log = g->history;
+    if (log->count == 0)
+        return;
+
+    Checkpoint* cp = &log->checkpoints[log->count - 1];
+    if (cp->playerSaved)
+        return;
+
+    Player* player = g->player;
+    cp->player.hp = player->hp;
+    cp->player.maxHp = player->maxHp;
+    cp->player.baseAttack = player->baseAttack;
+    cp->player.currentRoom = player->currentRoom;
+    cp->player.bag = bstVersion(player->bag);
+    cp->player.defeated = bstVersion(player->defeatedMonsters);
+    cp->playerSaved = 1;
+}
+
+//records an object that did not exist at the last checkpoint
+void checkpointCreated(GameState* g, void* object, void (*freeObject)(void*)) {
+    CheckpointLog* log = g->history;
+    //arena objects are never freed one by one, nothing to track
+    if (log->count == 0 || freeObject == NULL)
+        return;
+
+    if (log->createdCount == log->createdCapacity)
+        log->created = (CreatedObject*)growArray(log->created, &log->createdCapacity, sizeof(CreatedObject));
+    log->created[log->createdCount].object = object;
+    log->created[log->createdCount++].freeObject = freeObject;
+}
+
+static void releasePlayerUndo(PlayerUndo* undo) {
+    bstRelease(undo->bag);
+    bstRelease(undo->defeated);
+}
+
+/*
+ * Puts the game back to checkpoint number checkpoint. That checkpoint
+ * stays and can be restored again, every later one is dropped. Only the
+ * rooms journaled since then are written back, so the cost is O(changes).
+ * Returns 0 if there is no such checkpoint.
+ */
+int gameRestore(GameState* g, int checkpoint) {
+    CheckpointLog* log = g->history;
+    if (log == NULL || checkpoint < 0 || checkpoint >= log->count)
+        return 0;
+
+    PROF_START(restore);
+    Checkpoint* target = &log->checkpoints[checkpoint];
+
+    //newest first, so a room changed in several intervals ends at its oldest value
+    for (int i = log->roomCount - 1; i >= target->roomMark; i--) {
+        RoomUndo* undo = &log->rooms[i];
+        Room* room = undo->room;
+        room->monster = undo->monster;
+        room->item = undo->item;
+        room->visited = undo->visited;
+        if (room->monster != NULL)
+            room->monster->hp = undo->monsterHp;
+        roomContentsChanged(g, room);
+    }
+    log->roomCount = target->roomMark;
+
+    //the same goes for the player, saved at most once per checkpoint
+    Player* player = g->player;
+    for (int i = log->count - 1; i >= checkpoint; i--) {
+        Checkpoint* cp = &log->checkpoints[i];
+        if (!cp->playerSaved)
+            continue;
+        player->hp = cp->player.hp;
+        player->maxHp = cp->player.maxHp;
+        player->baseAttack = cp->player.baseAttack;
+        player->currentRoom = cp->player.currentRoom;
+        bstSetVersion(player->bag, cp->player.bag);
+        bstSetVersion(player->defeatedMonsters, cp->player.defeated);
+        releasePlayerUndo(&cp->player);
+        cp->playerSaved = 0;
+    }
+
+    //monsters and items added since then are referenced by nothing any more
+    for (int i = target->createdMark; i < log->createdCount; i++)
+        log->created[i].freeObject(log->created[i].object);
+    log->createdCount = target->createdMark;
+
+    g->unvisitedRooms = target->unvisitedRooms;
+    g->monstersRemaining = target->monstersRemaining;
+
+    //a fresh serial, the stamps of the rolled back changes no longer count
+    target->serial = ++log->nextSerial;
+    log->count = checkpoint + 1;
+    PROF_STOP(restore, PROF_CHECKPOINT_RESTORE);
+    return 1;
+}
+
+//forgets every checkpoint, checkpoints stay enabled
+void gameDropCheckpoints(GameState* g) {
+    CheckpointLog* log = g->history;
+    if (log == NULL)
+        return;
+
+    for (int i = 0; i < log->count; i++)
+        if (log->checkpoints[i].playerSaved)
+            releasePlayerUndo(&log->checkpoints[i].player);
+    log->count = 0;
+    log->roomCount = 0;
+    log->createdCount = 0;
+}
+
+//releases the journal, the game objects it points to belong to the game
+void checkpointFree(GameState* g) {
+    CheckpointLog* log = g->history;
+    if (log == NULL)
+        return;
+
+    gameDropCheckpoints(g);
+    free(log->checkpoints);
+    free(log->rooms);
+    free(log->created);
+    free(log->roomStamp);
+    free(log);
+    g->history = NULL;
+}
@@ -0,0 +1,77 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "game.h"
+
+/*
+ * Undo checkpoints for "try this, then roll back". Taking one is O(1):
+ * from then on the first change to a room (visited, monster, item and the
+ * monster's hp) or to the player (stats, current room, bag and monster log
+ * versions) saves its old value in a journal, later changes to the same
+ * room or player until the next checkpoint save nothing. Restoring plays
+ * the journal back, so it costs O(changes) whatever the size of the world.
+ * The bag and monster log become persistent trees, which is why the
+ * B-tree backend cannot take checkpoints.
+ * The room layout is not journaled: adding a room or initializing the
+ * player again drops every checkpoint.
+ */
+typedef struct {
+    Room* room;
+    Monster* monster;
+    Item* item;
+    int visited;
+    int monsterHp;
+} RoomUndo;
+
+typedef struct {
+    int hp;
+    int maxHp;
+    int baseAttack;
+    Room* currentRoom;
+    BSTNode* bag;           // held versions, released with the checkpoint
+    BSTNode* defeated;
+} PlayerUndo;
+
+typedef struct {
+    int roomMark;           // journal lengths when the checkpoint was taken
+    int createdMark;
+    int unvisitedRooms;
+    int monstersRemaining;
+    int serial;             // rooms stamped with it are already journaled
+    int playerSaved;
+    PlayerUndo player;
+} Checkpoint;
+
+//monster or item added after a checkpoint, freed if it is rolled back
+typedef struct {
+    void* object;
+    void (*freeObject)(void*);
+} CreatedObject;
+
+typedef struct CheckpointLog {
+    Checkpoint* checkpoints;
+    int count;
+    int capacity;
+    RoomUndo* rooms;
+    int roomCount;
+    int roomCapacity;
+    CreatedObject* created;
+    int createdCount;
+    int createdCapacity;
+    int* roomStamp;         // per room id, serial of the last journaled change
+    int stampCapacity;
+    int nextSerial;
+} CheckpointLog;
+
+int checkpointEnable(GameState* g);
+int gameCheckpoint(GameState* g);
+int gameRestore(GameState* g, int checkpoint);
+void gameDropCheckpoints(GameState* g);
+void checkpointFree(GameState* g);
+
+// Journal hooks of the step engine, only called while checkpoints are enabled
+void checkpointTouchRoom(GameState* g, Room* room);
+void checkpointTouchPlayer(GameState* g);
+void checkpointCreated(GameState* g, void* object, void (*freeObject)(void*));
+
+#endif
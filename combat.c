@@ -0,0 +1,327 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef GAME_DEBUG
+#include <assert.h>
+#endif
+#include "combat.h"
+#include "prof.h"
+
+/*
+ * Vector paths: SSE2 is part of every x86-64 target, AVX2 is picked at run
+ * time on GCC/Clang and at compile time (/arch:AVX2) on MSVC.
+ */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COMBAT_SSE2 1
+#include <immintrin.h>
+#endif
+
+#if defined(COMBAT_SSE2) && defined(__GNUC__)
+#define COMBAT_AVX2 1
+#define COMBAT_AVX2_TARGET __attribute__((target("avx2")))
+#define combatHasAvx2() __builtin_cpu_supports("avx2")
+#elif defined(COMBAT_SSE2) && defined(__AVX2__)
+#define COMBAT_AVX2 1
+#define COMBAT_AVX2_TARGET
+#define combatHasAvx2() 1
+#endif
+
+#define SOA_MIN_CAPACITY 16
+#define COUNT_CHUNK 256
+
+// Appends one monster to the flat arrays
+void monsterSoAAdd(MonsterSoA* m, const Monster* monster) {
+    if (m->count == m->capacity) {
+        int newCapacity = m->capacity ? m->capacity * 2 : SOA_MIN_CAPACITY;
+        int* hp = (int*)realloc(m->hp, newCapacity * sizeof(int));
+        if (hp == NULL)
+            exit(1);
+        m->hp = hp;
+        int* attack = (int*)realloc(m->attack, newCapacity * sizeof(int));
+        if (attack == NULL)
+            exit(1);
+        m->attack = attack;
+        unsigned char* type = (unsigned char*)realloc(m->type, newCapacity);
+        if (type == NULL)
+            exit(1);
+        m->type = type;
+        m->capacity = newCapacity;
+    }
+
+    m->hp[m->count] = monster->hp;
+    m->attack[m->count] = monster->attack;
+    m->type[m->count] = (unsigned char)monster->type;
+    m->count++;
+}
+
+// Copies every monster still standing in a room, returns how many were added
+int monsterSoACollect(MonsterSoA* m, const GameState* g) {
+    int before = m->count;
+    //the monster bitset skips empty rooms 64 at a time
+    for (int id = roomStoreNextMonster(&g->roomStore, 0); id >= 0;
+        id = roomStoreNextMonster(&g->roomStore, id + 1))
+        monsterSoAAdd(m, g->roomTable[id]->monster);
+    return m->count - before;
+}
+
+void monsterSoAFree(MonsterSoA* m) {
+    free(m->hp);
+    free(m->attack);
+    free(m->type);
+    memset(m, 0, sizeof(*m));
+}
+
+/*
+ * Fills the batch with every (hp, attack) pair of the two ranges, hp major,
+ * so configuration h * columns + a has the h-th hp and the a-th attack.
+ * Returns the number of attack columns, or 0 if a range is empty.
+ */
+int playerBatchGrid(PlayerBatch* batch, int hpFrom, int hpTo, int hpStep,
+    int attackFrom, int attackTo, int attackStep) {
+    memset(batch, 0, sizeof(*batch));
+    if (hpStep <= 0 || attackStep <= 0 || hpFrom > hpTo || attackFrom > attackTo)
+        return 0;
+
+    long long rows = ((long long)hpTo - hpFrom) / hpStep + 1;
+    long long columns = ((long long)attackTo - attackFrom) / attackStep + 1;
+    if (rows * columns > INT_MAX)
+        return 0;
+
+    batch->count = (int)(rows * columns);
+    batch->hp = (int*)malloc(batch->count * sizeof(int));
+    batch->attack = (int*)malloc(batch->count * sizeof(int));
+    if (batch->hp == NULL || batch->attack == NULL)
+        exit(1);
+
+    int i = 0;
+    for (long long h = 0; h < rows; h++) {
+        for (long long a = 0; a < columns; a++) {
+            batch->hp[i] = (int)(hpFrom + h * hpStep);
+            batch->attack[i] = (int)(attackFrom + a * attackStep);
+            i++;
+        }
+    }
+    return (int)columns;
+}
+
+void playerBatchFree(PlayerBatch* batch) {
+    free(batch->hp);
+    free(batch->attack);
+    memset(batch, 0, sizeof(*batch));
+}
+
+//one lane through resolveFight, with hp left clamped to [0, INT_MAX]
+static void evaluateScalar(int monsterHp, int monsterAttack, const int* hp, const int* attack,
+    int count, unsigned char* outcome, int* hpLeft) {
+    for (int i = 0; i < count; i++) {
+        FightResult r = resolveFight(hp[i], attack[i], monsterHp, monsterAttack);
+        outcome[i] = r.endless ? FIGHT_ENDLESS : r.playerWon ? FIGHT_WON : FIGHT_LOST;
+
+        long long left = r.playerHp < 0 ? 0 : r.playerHp;
+        hpLeft[i] = left > INT_MAX ? INT_MAX : (int)left;
+    }
+}
+
+//bit l of a lane mask moved to byte l, so a whole vector of outcomes is one store
+static const unsigned int laneBytes[16] = {
+    0x00000000, 0x00000001, 0x00000100, 0x00000101,
+    0x00010000, 0x00010001, 0x00010100, 0x00010101,
+    0x01000000, 0x01000001, 0x01000100, 0x01000101,
+    0x01010000, 0x01010001, 0x01010100, 0x01010101
+};
+
+//won and endless never share a lane, so the outcome byte is won + 2 * endless
+static void storeLanes(int lanes, int wonMask, int endlessMask, unsigned char* outcome) {
+    unsigned int bytes = laneBytes[wonMask] + 2 * laneBytes[endlessMask];
+    for (int l = 0; l < lanes; l++)
+        outcome[l] = (unsigned char)(bytes >> (8 * l));
+}
+
+#ifdef COMBAT_SSE2
+/*
+ * Two configurations per step in doubles: every int32 quotient is exact, so
+ * ceil(hp / attack) matches the integer formula. SSE2 has no ceil, the
+ * truncated quotient is bumped by one where it fell short.
+ */
+static __m128d ceilPositive(__m128d q) {
+    __m128d t = _mm_cvtepi32_pd(_mm_cvttpd_epi32(q));
+    return _mm_add_pd(t, _mm_and_pd(_mm_cmplt_pd(t, q), _mm_set1_pd(1.0)));
+}
+
+static void evaluateSse2(int monsterHp, int monsterAttack, const int* hp, const int* attack,
+    int count, unsigned char* outcome, int* hpLeft) {
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d inf = _mm_set1_pd(INFINITY);
+    const __m128d hpMax = _mm_set1_pd((double)INT_MAX);
+    const __m128d mhp = _mm_set1_pd(monsterHp);
+    const __m128d ma = _mm_set1_pd(monsterAttack);
+    const __m128d maPositive = _mm_cmpgt_pd(ma, zero);
+
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d php = _mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(hp + i)));
+        __m128d pa = _mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(attack + i)));
+
+        //strikes the player needs: 1 if one blow does it, never if it cannot hurt
+        __m128d pn = ceilPositive(_mm_div_pd(mhp, pa));
+        pn = _mm_or_pd(_mm_and_pd(_mm_cmpgt_pd(pa, zero), pn), _mm_andnot_pd(_mm_cmpgt_pd(pa, zero), inf));
+        __m128d oneBlow = _mm_cmpge_pd(pa, mhp);
+        pn = _mm_or_pd(_mm_and_pd(oneBlow, one), _mm_andnot_pd(oneBlow, pn));
+
+        __m128d mn = ceilPositive(_mm_div_pd(php, ma));
+        mn = _mm_or_pd(_mm_and_pd(maPositive, mn), _mm_andnot_pd(maPositive, inf));
+        oneBlow = _mm_cmpge_pd(ma, php);
+        mn = _mm_or_pd(_mm_and_pd(oneBlow, one), _mm_andnot_pd(oneBlow, mn));
+
+        //a player who starts at 0 hp or below never strikes and never wins
+        __m128d alive = _mm_cmpgt_pd(php, zero);
+        __m128d pFinite = _mm_cmplt_pd(pn, inf);
+        __m128d aliveWon = _mm_and_pd(alive, _mm_and_pd(pFinite, _mm_cmple_pd(pn, mn)));
+        __m128d endless = _mm_and_pd(alive, _mm_andnot_pd(pFinite, _mm_cmpeq_pd(mn, inf)));
+
+        //hp after a win, the untouched hp of an endless fight, 0 otherwise
+        __m128d left = _mm_sub_pd(php, _mm_mul_pd(_mm_sub_pd(pn, one), ma));
+        left = _mm_min_pd(_mm_max_pd(left, zero), hpMax);
+        left = _mm_or_pd(_mm_and_pd(aliveWon, left), _mm_and_pd(endless, php));
+        _mm_storel_epi64((__m128i*)(hpLeft + i), _mm_cvttpd_epi32(left));
+
+        storeLanes(2, _mm_movemask_pd(aliveWon), _mm_movemask_pd(endless), outcome + i);
+    }
+    evaluateScalar(monsterHp, monsterAttack, hp + i, attack + i, count - i, outcome + i, hpLeft + i);
+}
+#endif
+
+#ifdef COMBAT_AVX2
+// Same lanes as the SSE2 path, four configurations per step
+COMBAT_AVX2_TARGET
+static void evaluateAvx2(int monsterHp, int monsterAttack, const int* hp, const int* attack,
+    int count, unsigned char* outcome, int* hpLeft) {
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d inf = _mm256_set1_pd(INFINITY);
+    const __m256d hpMax = _mm256_set1_pd((double)INT_MAX);
+    const __m256d mhp = _mm256_set1_pd(monsterHp);
+    const __m256d ma = _mm256_set1_pd(monsterAttack);
+    const __m256d maPositive = _mm256_cmp_pd(ma, zero, _CMP_GT_OQ);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d php = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(hp + i)));
+        __m256d pa = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(attack + i)));
+
+        __m256d pn = _mm256_ceil_pd(_mm256_div_pd(mhp, pa));
+        pn = _mm256_blendv_pd(inf, pn, _mm256_cmp_pd(pa, zero, _CMP_GT_OQ));
+        pn = _mm256_blendv_pd(pn, one, _mm256_cmp_pd(pa, mhp, _CMP_GE_OQ));
+
+        __m256d mn = _mm256_ceil_pd(_mm256_div_pd(php, ma));
+        mn = _mm256_blendv_pd(inf, mn, maPositive);
+        mn = _mm256_blendv_pd(mn, one, _mm256_cmp_pd(ma, php, _CMP_GE_OQ));
+
+        __m256d alive = _mm256_cmp_pd(php, zero, _CMP_GT_OQ);
+        __m256d pFinite = _mm256_cmp_pd(pn, inf, _CMP_LT_OQ);
+        __m256d aliveWon = _mm256_and_pd(alive, _mm256_and_pd(pFinite, _mm256_cmp_pd(pn, mn, _CMP_LE_OQ)));
+        __m256d endless = _mm256_and_pd(alive, _mm256_andnot_pd(pFinite, _mm256_cmp_pd(mn, inf, _CMP_EQ_OQ)));
+
+        __m256d left = _mm256_sub_pd(php, _mm256_mul_pd(_mm256_sub_pd(pn, one), ma));
+        left = _mm256_min_pd(_mm256_max_pd(left, zero), hpMax);
+        left = _mm256_or_pd(_mm256_and_pd(aliveWon, left), _mm256_and_pd(endless, php));
+        _mm_storeu_si128((__m128i*)(hpLeft + i), _mm256_cvttpd_epi32(left));
+
+        storeLanes(4, _mm256_movemask_pd(aliveWon), _mm256_movemask_pd(endless), outcome + i);
+    }
+    evaluateScalar(monsterHp, monsterAttack, hp + i, attack + i, count - i, outcome + i, hpLeft + i);
+}
+#endif
+
+// Name of the vector path combatEvaluate uses on this machine
+const char* combatBackend(void) {
+#ifdef COMBAT_AVX2
+    if (combatHasAvx2())
+        return "avx2";
+#endif
+#ifdef COMBAT_SSE2
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+/*
+ * Fights monster number `monster` against every configuration of the batch.
+ * outcome gets a FightOutcome per configuration, hpLeft the player hp after
+ * the fight clamped to [0, INT_MAX] (a lost fight always leaves 0).
+ */
+void combatEvaluate(const MonsterSoA* monsters, int monster, const PlayerBatch* players,
+    unsigned char* outcome, int* hpLeft) {
+    int mhp = monsters->hp[monster];
+    int ma = monsters->attack[monster];
+
+#if defined(COMBAT_AVX2)
+    if (combatHasAvx2())
+        evaluateAvx2(mhp, ma, players->hp, players->attack, players->count, outcome, hpLeft);
+    else
+        evaluateSse2(mhp, ma, players->hp, players->attack, players->count, outcome, hpLeft);
+#elif defined(COMBAT_SSE2)
+    evaluateSse2(mhp, ma, players->hp, players->attack, players->count, outcome, hpLeft);
+#else
+    evaluateScalar(mhp, ma, players->hp, players->attack, players->count, outcome, hpLeft);
+#endif
+
+#ifdef GAME_DEBUG
+    for (int i = 0; i < players->count; i++) {
+        unsigned char expectOutcome;
+        int expectHp;
+        evaluateScalar(mhp, ma, players->hp + i, players->attack + i, 1, &expectOutcome, &expectHp);
+        assert(outcome[i] == expectOutcome && hpLeft[i] == expectHp);
+    }
+#endif
+}
+
+// Adds, per configuration, the number of monsters of the world it beats one on one
+void combatCountWins(const MonsterSoA* monsters, const PlayerBatch* players, int* wins) {
+    unsigned char outcome[COUNT_CHUNK];
+    int hpLeft[COUNT_CHUNK];
+
+    //chunks keep the scratch arrays on the stack and in L1
+    for (int start = 0; start < players->count; start += COUNT_CHUNK) {
+        PlayerBatch chunk = { players->hp + start, players->attack + start, players->count - start };
+        if (chunk.count > COUNT_CHUNK)
+            chunk.count = COUNT_CHUNK;
+
+        for (int m = 0; m < monsters->count; m++) {
+            combatEvaluate(monsters, m, &chunk, outcome, hpLeft);
+            for (int i = 0; i < chunk.count; i++)
+                wins[start + i] += outcome[i] == FIGHT_WON;
+        }
+    }
+}
+
+// Prints the percentage of monsters each (hp, attack) configuration beats
+void combatPrintMatrix(const MonsterSoA* monsters, const PlayerBatch* players,
+    int columns, FILE* out) {
+    int* wins = (int*)calloc(players->count > 0 ? players->count : 1, sizeof(int));
+    if (wins == NULL)
+        exit(1);
+    combatCountWins(monsters, players, wins);
+
+    fprintf(out, "=== WIN MATRIX (%% of %d monsters beaten, %s) ===\n",
+        monsters->count, combatBackend());
+    fprintf(out, "%8s", "hp\\atk");
+    for (int a = 0; a < columns; a++)
+        fprintf(out, " %5d", players->attack[a]);
+    fprintf(out, "\n");
+
+    for (int i = 0; i < players->count; i += columns) {
+        fprintf(out, "%8d", players->hp[i]);
+        for (int a = 0; a < columns; a++) {
+            int percent = monsters->count > 0 ? wins[i + a] * 100 / monsters->count : 0;
+            fprintf(out, " %5d", percent);
+        }
+        fprintf(out, "\n");
+    }
+    free(wins);
+}
@@ -0,0 +1,44 @@
+#ifndef COMBAT_H
+#define COMBAT_H
+
+#include <stdio.h>
+#include "game.h"
+
+/*
+ * Batch combat for balance sweeps: the monsters of a world are copied into
+ * flat arrays, and one monster is fought against a whole vector of player
+ * configurations at a time (AVX2 or SSE2 where available, scalar otherwise).
+ * Every lane gives the same answer as resolveFight.
+ */
+typedef enum { FIGHT_LOST = 0, FIGHT_WON = 1, FIGHT_ENDLESS = 2 } FightOutcome;
+
+typedef struct {
+    int* hp;
+    int* attack;
+    unsigned char* type;
+    int count;
+    int capacity;
+} MonsterSoA;
+
+typedef struct {
+    int* hp;                // player max hp per configuration
+    int* attack;            // player base attack per configuration
+    int count;
+} PlayerBatch;
+
+void monsterSoAAdd(MonsterSoA* monsters, const Monster* monster);
+int monsterSoACollect(MonsterSoA* monsters, const GameState* g);
+void monsterSoAFree(MonsterSoA* monsters);
+
+int playerBatchGrid(PlayerBatch* batch, int hpFrom, int hpTo, int hpStep,
+    int attackFrom, int attackTo, int attackStep);
+void playerBatchFree(PlayerBatch* batch);
+
+void combatEvaluate(const MonsterSoA* monsters, int monster, const PlayerBatch* players,
+    unsigned char* outcome, int* hpLeft);
+void combatCountWins(const MonsterSoA* monsters, const PlayerBatch* players, int* wins);
+const char* combatBackend(void);
+void combatPrintMatrix(const MonsterSoA* monsters, const PlayerBatch* players,
+    int columns, FILE* out);
+
+#endif
@@ -1,9 +1,15 @@
 #define _CRT_SECURE_NO_WARNINGS
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef GAME_DEBUG
+#include <assert.h>
+#endif
+#include "checkpoint.h"
 #include "game.h"
+#include "prof.h"
 #include "utils.h"
 
 #define LEGEND_MONSTER 'M'
@@ -14,144 +20,296 @@
 //static functions
 static void displayMap(GameState* g);
 static void computeNewCoords(int roomDirec, int* x, int* y);
-static Room* findRoomById(Room* head, int roomID);
-static int isRoomOccupied(Room* head, int x, int y);
+static Room* findRoomById(GameState* g, int roomID);
+static void growRoomTable(GameState* g);
+static int isRoomOccupied(GameState* g, int x, int y);
 static void printOrderOptions(GameState* g, BST* tree, void (*printFunc)(void*));
 static int checkWinCondition(GameState* g);
+static void visitRoom(GameState* g, Room* room);
+static void* gameAlloc(GameState* g, size_t size);
+static char* copyName(GameState* g, const char* name);
+static void mapCacheAddRoom(GameState* g, Room* room);
+static void touchRoom(GameState* g, Room* room);
+static void touchPlayer(GameState* g);
+static void freeMapCache(MapCache* cache);
+
+//free functions
+static void freeRoom(Room* room);
+static void freePlayer(Player* player, int inArena);
+static void freeGameState(GameState* game);
+static void roomMemoryReport(GameState* g, FILE* out);
 static void handleWin(GameState* g);
 
 typedef enum { MOVE = 1, FIGHT = 2, PICKUP = 3, 
-               BAG = 4, DEFEATED = 5, QUIT = 6 } GameAction;
+               BAG = 4, DEFEATED = 5, QUIT = 6,
+               CHECKPOINT = 7, UNDO = 8,        // only with checkpoints enabled
+               PROFILE_DUMP = 9 } GameAction;   // hidden, GAME_PROFILE builds only
 
 typedef enum { PREORDER = 1, INORDER = 2, POSTORDER = 3 } Order;
 
-// Print the game legend (which rooms contain monsters/items)
-static void printLegend(Room* room) {//change to room*
-    printf("=== ROOM LEGEND ===\n");
+#define GRID_MIN_SIDE 16
+#define GRID_MAX_CELLS (1LL << 24)   // 64 MB of room ids
+
+// Print the game legend (which rooms contain monsters/items) into the frame
+void printLegend(GameState* g) {
+    MapCache* cache = &g->mapCache;
+    FrameBuffer* text = &cache->legendText;
+
+    //only rooms created since the last frame need a new line, read from the room store
+    const RoomStore* store = &g->roomStore;
+    for (int id = cache->legendRooms; id < g->roomCount; id++) {
+        if (id == cache->legendCapacity) {
+            int newCapacity = cache->legendCapacity ? cache->legendCapacity * 2 : 16;
+            size_t* newSlots = (size_t*)realloc(cache->legendSlots, newCapacity * sizeof(size_t));
+            if (newSlots == NULL)
+                exit(1);
+            cache->legendSlots = newSlots;
+            cache->legendCapacity = newCapacity;
+        }
 
-    // Iterate over the linked list of rooms
-    for (Room* r = room; r != NULL; r = r->next) {
+        // Format: ID 1: [M:X] [I:V]
+        fbAppendLiteral(text, "ID ");
+        fbAppendInt(text, id, 0);
+        fbAppendLiteral(text, ": [");
+        fbAppendChar(text, LEGEND_MONSTER);
+        fbAppendChar(text, ':');
+        cache->legendSlots[id] = text->len;
+        fbAppendChar(text, roomStoreTest(store->hasMonster, id) ? LEGEND_PRESENT : LEGEND_ABSENT);
+        fbAppendLiteral(text, "] [");
+        fbAppendChar(text, LEGEND_ITEM);
+        fbAppendChar(text, ':');
+        fbAppendChar(text, roomStoreTest(store->hasItem, id) ? LEGEND_PRESENT : LEGEND_ABSENT);
+        fbAppendLiteral(text, "]\n");
+    }
+    cache->legendRooms = g->roomCount;
 
-        // Determine status chars based on existence (V or X)
-        char mStatus = (r->monster != NULL) ? LEGEND_PRESENT : LEGEND_ABSENT;
-        char iStatus = (r->item != NULL) ? LEGEND_PRESENT : LEGEND_ABSENT;
+    fbAppendLiteral(&g->frame, "=== ROOM LEGEND ===\n");
+    fbAppend(&g->frame, text->data, text->len);
+    fbAppendLiteral(&g->frame, "===================\n");
+}
 
-        // Print using the defined constants for M/I and V/X
-        // Format: ID 1: [M:X] [I:V]
-        printf("ID %d: [%c:%c] [%c:%c]\n",
-            r->id,
-            LEGEND_MONSTER, mStatus,
-            LEGEND_ITEM, iStatus);
+// Syncs the room store and the legend line of a room after its monster, item or visited flag changed
+void roomContentsChanged(GameState* g, Room* room) {
+    RoomStore* store = &g->roomStore;
+    roomStoreSet(store->visited, room->id, room->visited);
+    roomStoreSet(store->hasMonster, room->id, room->monster != NULL);
+    roomStoreSet(store->hasItem, room->id, room->item != NULL);
+
+    MapCache* cache = &g->mapCache;
+    if (room->id >= cache->legendRooms)
+        return;
+
+    // "M:<m>] [I:<i>" - the item status sits 6 chars after the monster one
+    size_t slot = cache->legendSlots[room->id];
+    cache->legendText.data[slot] = (room->monster != NULL) ? LEGEND_PRESENT : LEGEND_ABSENT;
+    cache->legendText.data[slot + 6] = (room->item != NULL) ? LEGEND_PRESENT : LEGEND_ABSENT;
+}
+
+// New side length so coord fits: at least double the old one, capped at GRID_MAX_CELLS / other
+static long long grownSide(long long side, long long need, long long other) {
+    long long grown = side * 2 > need ? side * 2 : need;
+    if (grown * other > GRID_MAX_CELLS)
+        grown = need;
+    return grown;
+}
+
+/*
+ * Reallocates the grid so (x, y) fits, growing at least 2x on the side that
+ * overflowed. Spans are worked out in 64 bits, rooms can sit anywhere in the
+ * int range. Returns 0 and leaves the grid alone if it would need more than
+ * GRID_MAX_CELLS cells or the memory is not there.
+ */
+static int growGrid(MapCache* cache, int x, int y) {
+    long long newOriginX = cache->originX, newOriginY = cache->originY;
+    long long newWide = cache->cellsWide, newHigh = cache->cellsHigh;
+
+    if (cache->cells == NULL) {
+        newWide = newHigh = GRID_MIN_SIDE;
+        newOriginX = (long long)x - GRID_MIN_SIDE / 2;
+        newOriginY = (long long)y - GRID_MIN_SIDE / 2;
+    }
+    else {
+        long long oldEndX = cache->originX + cache->cellsWide;
+        long long oldEndY = cache->originY + cache->cellsHigh;
+
+        if (x < cache->originX) {
+            newWide = grownSide(cache->cellsWide, oldEndX - x, cache->cellsHigh);
+            newOriginX = oldEndX - newWide;
+        }
+        else if (x >= oldEndX)
+            newWide = grownSide(cache->cellsWide, x - cache->originX + 1, cache->cellsHigh);
+
+        if (y < cache->originY) {
+            newHigh = grownSide(cache->cellsHigh, oldEndY - y, newWide);
+            newOriginY = oldEndY - newHigh;
+        }
+        else if (y >= oldEndY)
+            newHigh = grownSide(cache->cellsHigh, y - cache->originY + 1, newWide);
+    }
+
+    if (newWide * newHigh > GRID_MAX_CELLS)
+        return 0;
+    size_t cellCount = (size_t)(newWide * newHigh);
+    int* newCells = (int*)malloc(cellCount * sizeof(int));
+    if (newCells == NULL)
+        return 0;
+    for (size_t i = 0; i < cellCount; i++)
+        newCells[i] = -1;
+
+    //copy the old grid row by row into its place in the new one
+    for (int row = 0; row < cache->cellsHigh; row++) {
+        int* src = cache->cells + (size_t)row * cache->cellsWide;
+        int* dst = newCells + (size_t)(row + cache->originY - newOriginY) * newWide
+            + (size_t)(cache->originX - newOriginX);
+        memcpy(dst, src, cache->cellsWide * sizeof(int));
     }
 
-    printf("===================\n");
+    free(cache->cells);
+    cache->cells = newCells;
+    cache->originX = newOriginX;
+    cache->originY = newOriginY;
+    cache->cellsWide = (int)newWide;
+    cache->cellsHigh = (int)newHigh;
+    return 1;
 }
 
-// Map display functions
-static void displayMap(GameState* g) {
-    if (!g->rooms) 
+// Writes a new room into the grid, growing it only when the bounds extend
+static void mapCacheAddRoom(GameState* g, Room* room) {
+    MapCache* cache = &g->mapCache;
+
+    if (room->x < cache->minX) cache->minX = room->x;
+    if (room->x > cache->maxX) cache->maxX = room->x;
+    if (room->y < cache->minY) cache->minY = room->y;
+    if (room->y > cache->maxY) cache->maxY = room->y;
+    cache->mapDirty = 1;
+
+    if (cache->gridOff)
         return;
-    
-    // Find bounds
-    int minX = 0, maxX = 0, minY = 0, maxY = 0;
-    for (Room* r = g->rooms; r; r = r->next) {
-        if (r->x < minX) minX = r->x;
-        if (r->x > maxX) maxX = r->x;
-        if (r->y < minY) minY = r->y;
-        if (r->y > maxY) maxY = r->y;
+    if (cache->cells == NULL
+        || room->x < cache->originX || room->x >= cache->originX + cache->cellsWide
+        || room->y < cache->originY || room->y >= cache->originY + cache->cellsHigh) {
+        //the bounding box only grows, so once the grid is off it stays off
+        if (!growGrid(cache, room->x, room->y)) {
+            free(cache->cells);
+            cache->cells = NULL;
+            cache->gridOff = 1;
+            return;
+        }
     }
-    
-    int width = maxX - minX + 1;
-    int height = maxY - minY + 1;
-    
-    // Create grid
-    int** grid = malloc(height * sizeof(int*));
-    for (int i = 0; i < height; i++) {
-        grid[i] = malloc(width * sizeof(int));
-        for (int j = 0; j < width; j++) grid[i][j] = -1;
+
+    cache->cells[(size_t)(room->y - cache->originY) * cache->cellsWide
+        + (size_t)(room->x - cache->originX)] = room->id;
+}
+
+// Room id at (x, y) for the map, from the grid or, without one, the room index
+static int mapCellAt(GameState* g, long long x, long long y) {
+    MapCache* cache = &g->mapCache;
+    if (!cache->gridOff) {
+        //the map always shows (0, 0), which the grid only covers if a room is near it
+        if (x < cache->originX || x >= cache->originX + cache->cellsWide
+            || y < cache->originY || y >= cache->originY + cache->cellsHigh)
+            return -1;
+        return cache->cells[(size_t)(y - cache->originY) * cache->cellsWide + (size_t)(x - cache->originX)];
     }
-    
-    for (Room* r = g->rooms; r; r = r->next)
-        grid[r->y - minY][r->x - minX] = r->id;
-    
-    printf("=== SPATIAL MAP ===\n");
-    for (int i = 0; i < height; i++) {
-        for (int j = 0; j < width; j++) {
-            if (grid[i][j] != -1) printf("[%2d]", grid[i][j]);
-            else printf("    ");
+
+    Room* room = findRoomByCoords(g, (int)x, (int)y);
+    return room != NULL ? room->id : -1;
+}
+
+// Map display functions, the text is only rebuilt after a room was added
+static void displayMap(GameState* g) {
+    if (!g->rooms) 
+        return;
+
+    MapCache* cache = &g->mapCache;
+    FrameBuffer* text = &cache->mapText;
+
+    if (cache->mapDirty) {
+        fbBegin(text);
+        fbAppendLiteral(text, "=== SPATIAL MAP ===\n");
+        for (long long y = cache->minY; y <= cache->maxY; y++) {
+            for (long long x = cache->minX; x <= cache->maxX; x++) {
+                int id = mapCellAt(g, x, y);
+                if (id != -1) {
+                    fbAppendChar(text, '[');
+                    fbAppendInt(text, id, 2);
+                    fbAppendChar(text, ']');
+                }
+                else {
+                    fbAppendLiteral(text, "    ");
+                }
+            }
+            fbAppendChar(text, '\n');
         }
-        printf("\n");
+        cache->mapDirty = 0;
     }
-    
-    for (int i = 0; i < height; i++) free(grid[i]);
-    free(grid);
+
+    fbAppend(&g->frame, text->data, text->len);
 }
 
-// Displays the current game map and room legend
+// Releases the grid and the cached text
+static void freeMapCache(MapCache* cache) {
+    free(cache->cells);
+    fbFree(&cache->mapText);
+    fbFree(&cache->legendText);
+    free(cache->legendSlots);
+    memset(cache, 0, sizeof(MapCache));
+}
+
+// Adds the current game map and room legend to the frame
 void displayGameStatus(GameState* g) {
+    PROF_START(map);
     displayMap(g);
-    printLegend(g->rooms);
+    PROF_STOP(map, PROF_DISPLAY_MAP);
+
+    PROF_START(legend);
+    printLegend(g);
+    PROF_STOP(legend, PROF_PRINT_LEGEND);
 }
 
-// Displays current room details and player status
+// Adds current room details and player status to the frame
 void displayRoomAndPlayerStatus(GameState* g) {
     //safety check
     if (g == NULL || g->player == NULL || g->player->currentRoom == NULL)
         return;
 
     Room* currRoom = g->player->currentRoom;
+    FrameBuffer* fb = &g->frame;
 
-    printf("--- Room %d ---\n", currRoom->id);
+    fbPrintf(fb, "--- Room %d ---\n", currRoom->id);
     
     if (currRoom->monster)
-        printf("Monster: %s (HP:%d)\n", currRoom->monster->name, currRoom->monster->hp);
+        fbPrintf(fb, "Monster: %s (HP:%d)\n", currRoom->monster->name, currRoom->monster->hp);
     
     if (currRoom->item)
-        printf("Item: %s\n", currRoom->item->name);
+        fbPrintf(fb, "Item: %s\n", currRoom->item->name);
     
-    printf("HP: %d/%d\n", g->player->hp, g->player->maxHp);
+    fbPrintf(fb, "HP: %d/%d\n", g->player->hp, g->player->maxHp);
 }
 
 // Creates a new room adjacent to an existing room and optionally adds a monster or item
 void addRoom(GameState* g) {
+    fbBegin(&g->frame);
     displayGameStatus(g);
-    int baseId = getInt("Attach to room ID", g);
-    Room* baseRoom = findRoomById(g->rooms, baseId);
-
-
-    int roomDirec = getInt(stringChooseDirection(), g);
+    fbFlush(&g->frame, stdout);
 
+    Command cmd = { .type = CMD_ADD_ROOM };
+    StepOutput out;
 
-    int x = baseRoom->x;
-    int y = baseRoom->y;
-    computeNewCoords(roomDirec, &x, &y);
-
-    if (isRoomOccupied(g->rooms, x, y)) {
-        printf("Room exists there\n");
-        return;
+    //the first room is always placed at the origin
+    if (g->rooms != NULL) {
+        cmd.roomId = getInt("Attach to room ID", g);
+        cmd.direction = (Direction)getInt(stringChooseDirection(), g);
     }
-    Room* newRoom = (Room*)malloc(sizeof(Room));
-    if (newRoom == NULL)
-        exit(1);
 
-    newRoom->x = x;
-    newRoom->y = y;
-    newRoom->id = g->roomCount++;
-    newRoom->visited = 0;
-    newRoom->monster = NULL;
-    newRoom->item = NULL;
-    newRoom->next = NULL;
-    
-    if (g->rooms == NULL) {
-        g->rooms = newRoom;
-    }
-    else {
-        Room* temp = g->rooms;
-        while (temp->next != NULL) {
-            temp = temp->next;
-        }
-        temp->next = newRoom;
+    PROF_START(add);
+    StepStatus status = gameStep(g, &cmd, &out);
+    PROF_STOP(add, PROF_ADD_ROOM);
+    if (status != STEP_OK) {
+        printf("%s", stepStatusMessage(out.status));
+        return;
     }
+    Room* newRoom = out.room;
 
     int addMonster = getInt("Add monster? (1=Yes, 0=No):", g);
     if (addMonster) {
@@ -165,146 +323,269 @@ void addRoom(GameState* g) {
     printf("Created room %d at (%d, %d)", newRoom->id, newRoom->x, newRoom->y);
 }
 
-// Helper function to allocate and initialize a monster in the room
-void addMonsterFunc(Room* room, GameState* g) {
-    // Allocate memory for the monster struct
-    room->monster = (Monster*)malloc(sizeof(Monster));
-    if (room->monster == NULL) {
-        exit(1);
+/*
+ * Allocates an empty room at (x, y) and registers it.
+ * Returns NULL if a room already exists at these coordinates.
+ */
+Room* createRoomAt(GameState* g, int x, int y) {
+    if (isRoomOccupied(g, x, y))
+        return NULL;
+
+    Room* newRoom = (Room*)gameAlloc(g, sizeof(Room));
+
+    newRoom->x = x;
+    newRoom->y = y;
+    newRoom->visited = 0;
+    newRoom->monster = NULL;
+    newRoom->item = NULL;
+
+    registerRoom(g, newRoom);
+    return newRoom;
+}
+
+/*
+ * Gives an already filled room the next id, links it at the end of the
+ * room list and registers it in the id table, the room store, the
+ * coordinate index, the map cache and the win counters.
+ * Returns 0 (and registers nothing) if its coordinates are taken.
+ */
+int registerRoom(GameState* g, Room* room) {
+    if (isRoomOccupied(g, room->x, room->y))
+        return 0;
+
+    //the layout is not journaled, a new room ends every checkpoint
+    gameDropCheckpoints(g);
+
+    room->id = g->roomCount++;
+    room->next = NULL;
+    roomStoreAdd(&g->roomStore);
+    roomStoreSet(g->roomStore.visited, room->id, room->visited);
+    roomStoreSet(g->roomStore.hasMonster, room->id, room->monster != NULL);
+    roomStoreSet(g->roomStore.hasItem, room->id, room->item != NULL);
+    if (!room->visited)
+        g->unvisitedRooms++;
+    if (room->monster)
+        g->monstersRemaining++;
+
+    if (g->rooms == NULL)
+        g->rooms = room;
+    else
+        g->lastRoom->next = room;
+    g->lastRoom = room;
+
+    if (room->id == g->roomCapacity)
+        growRoomTable(g);
+    g->roomTable[room->id] = room;
+
+    roomIndexInsert(&g->roomIndex, room->x, room->y, room);
+    mapCacheAddRoom(g, room);
+    return 1;
+}
+
+// Sizes the id table and coordinate index for count more rooms up front
+void reserveRooms(GameState* g, int count) {
+    int needed = g->roomCount + count;
+    if (needed > g->roomCapacity) {
+        Room** newTable = (Room**)realloc(g->roomTable, needed * sizeof(Room*));
+        if (newTable == NULL)
+            exit(1);
+        g->roomTable = newTable;
+        g->roomCapacity = needed;
     }
+    roomIndexReserve(&g->roomIndex, needed);
+    roomStoreReserve(&g->roomStore, needed);
+}
+
+// Reads monster details from the user and places the monster in the room
+void addMonsterFunc(Room* room, GameState* g) {
+    Command cmd = { .type = CMD_ADD_MONSTER };
+    StepOutput out;
 
     // Get monster details from user
-    room->monster->name = getString("Monster name: ");
-    room->monster->type = (MonsterType)getInt("Type (0-4): ", g);
+    char* name = getString("Monster name: ");
+    cmd.roomId = room->id;
+    cmd.name = name;
+    cmd.kind = getInt("Type (0-4): ", g);
     // Using getInt for safe integer input
-    room->monster->hp = getInt("HP: ",g);
-    room->monster->attack = getInt("Attack:",g);
+    cmd.hp = getInt("HP: ",g);
+    cmd.attack = getInt("Attack:",g);
+
+    gameStep(g, &cmd, &out);
+    free(name);
 }
 
-// Helper function to allocate and initialize an item in the room
+// Reads item details from the user and places the item in the room
 void addItemFunc(Room* room, GameState* g) {
-    // Allocate memory for the item struct
-    room->item = (Item*)malloc(sizeof(Item));
-    if (room->item == NULL) {
-        exit(1);
-    }
+    Command cmd = { .type = CMD_ADD_ITEM };
+    StepOutput out;
 
     // Get item details from user
-    room->item->name = getString("Item name: ");
-    // Assuming ItemType is an enum (0-3), we cast the integer input
-    room->item->type = (ItemType)getInt("Type (0=Armor, 1=Sword):", g);
-    room->item->value = getInt("Value: ", g);
+    char* name = getString("Item name: ");
+    cmd.roomId = room->id;
+    cmd.name = name;
+    cmd.kind = getInt("Type (0=Armor, 1=Sword):", g);
+    cmd.value = getInt("Value: ", g);
+
+    gameStep(g, &cmd, &out);
+    free(name);
 }
 
 // Updates coordinates based on the chosen movement direction
 static void computeNewCoords(int roomDirec, int* x, int* y) {
 
-    enum Direction direc = (enum Direction)roomDirec;
+    Direction direc = (Direction)roomDirec;
 
 
     switch (direc) {
     case UP:
-        y--;
+        (*y)--;
         break;
     case DOWN:
-        y++;
+        (*y)++;
         break;
     case RIGHT:
-        x++;
+        (*x)++;
         break;
     case LEFT:
-        x--;
+        (*x)--;
         break;
     }
 }
 
 //return 1 for occupied and 0 for free 
-static int isRoomOccupied(Room* head, int x, int y) {
-    Room* current = head;
-    while (current != NULL) {
-        if (current->x == x && current->y == y) {
-            return 1; // Occupied
-        }
-        current = current->next;
-    }
-    return 0; // Free
+static int isRoomOccupied(GameState* g, int x, int y) {
+    return roomIndexFind(&g->roomIndex, x, y) != NULL;
 }
 
-//Find a room in the linked list by its unique ID
-static Room* findRoomById(Room* head, int roomID) {
-    Room* current = head;
-    while (current != NULL) {
-        if (current->id == roomID)
-            return current;
-        current = current->next;
-    }
-    return NULL;
+//Find a room by its unique ID through the id table
+static Room* findRoomById(GameState* g, int roomID) {
+    if (roomID < 0 || roomID >= g->roomCount)
+        return NULL;
+    return g->roomTable[roomID];
 }
 
-/*
- * Initializes the player: allocates memory, sets initial stats (HP, Attack),
- * locates the starting room, and creates the backpack and monster log.
- */
+//doubles the id table so appending a room stays amortized O(1)
+static void growRoomTable(GameState* g) {
+    int newCapacity = g->roomCapacity ? g->roomCapacity * 2 : 16;
+    Room** newTable = (Room**)realloc(g->roomTable, newCapacity * sizeof(Room*));
+    if (newTable == NULL)
+        exit(1);
+
+    g->roomTable = newTable;
+    g->roomCapacity = newCapacity;
+}
+
+// Menu action: initializes the player through the engine
 void initPlayer(GameState* g) {
     //safety check
     if (g == NULL)
         return;
 
-    g->player = malloc(sizeof(Player));
-    if (g->player == NULL)
-        exit(1);
+    Command cmd = { .type = CMD_INIT_PLAYER };
+    StepOutput out;
+    PROF_START(init);
+    StepStatus status = gameStep(g, &cmd, &out);
+    PROF_STOP(init, PROF_INIT_PLAYER);
+    if (status != STEP_OK)
+        printf("%s", stepStatusMessage(out.status));
+}
 
-    g->player->maxHp = g->configMaxHp;
-    g->player->hp = g->configMaxHp;
-    //initialize first room as current room
-    g->player->currentRoom = findRoomById(g->rooms, 0);
-    g->player->currentRoom->visited = 1;
-    g->player->baseAttack = g->configBaseAttack;
-    g->player->bag = createBST(compareItems, printItem, freeItem);
-    g->player->defeatedMonsters = createBST(compareMonsters, printMonster, freeMonster);
+// Allocates a player with an empty bag and monster log, stats are left to the caller
+Player* createPlayer(GameState* g) {
+    Player* player = (Player*)gameAlloc(g, sizeof(Player));
+    player->currentRoom = NULL;
+
+    //arena objects are released in bulk, so the trees must not free them
+    int inArena = g->arena != NULL;
+    //checkpoints keep old versions of both trees around
+    if (g->history != NULL) {
+        player->bag = createPersistentBST(compareItems, printItem, inArena ? NULL : freeItem);
+        player->defeatedMonsters = createPersistentBST(compareMonsters, printMonster,
+            inArena ? NULL : freeMonster);
+    }
+    else if (g->useBTree) {
+        player->bag = createBTreeBST(sizeof(Item), compareItems, printItem, inArena ? NULL : freeItem);
+        player->defeatedMonsters = createBTreeBST(sizeof(Monster), compareMonsters, printMonster,
+            inArena ? NULL : freeMonster);
+    }
+    else {
+        player->bag = createBalancedBST(compareItems, printItem, inArena ? NULL : freeItem);
+        player->defeatedMonsters = createBalancedBST(compareMonsters, printMonster,
+            inArena ? NULL : freeMonster);
+    }
+    bstUseAggregate(player->bag, &bagBestAggregate);
+    bstUseArena(player->bag, g->arena);
+    bstUseArena(player->defeatedMonsters, g->arena);
+    return player;
 }
 
-/*
- * Compares two items based on a specific hierarchy:
- * 1. Name (lexicographical order).
- * 2. Value (integer comparison) - if names are equal.
- * 3. Type (enum comparison) - if names and values are equal.
- * Returns < 0 if item1 < item2, > 0 if item1 > item2, and 0 if identical.
- */
+//BST callback around itemOrder
 int compareItems(void* a, void* b) {
-    Item* item1 = (Item*)a;
-    Item* item2 = (Item*)b;
+    return itemOrder((const Item*)a, (const Item*)b);
+}
 
-    int res = strcmp(item1->name, item2->name);
-    if (res == 0)
-        res = item1->value - item2->value;
+/*
+ * The smallest item that can carry name: anything with that name sorts at
+ * or after it, so it bounds rank and range queries on the bag by name.
+ */
+Item itemProbe(const char* name) {
+    Item probe;
+    probe.name = (char*)name;
+    probe.sortKey = nameSortKey(name);
+    probe.type = ARMOR;
+    probe.value = INT_MIN;
+    return probe;
+}
 
-    if (res != 0)
-        return res;
+static void bagBestInit(void* agg, void* data) {
+    BagBest* best = (BagBest*)agg;
+    Item* item = (Item*)data;
 
-    return item1->type - item2->type;
+    for (int t = 0; t < ITEM_TYPE_COUNT; t++) {
+        best->name[t] = NULL;
+        best->value[t] = 0;
+    }
+    //types outside the enum are kept in the bag but never ranked
+    if (item->type >= 0 && item->type < ITEM_TYPE_COUNT) {
+        best->name[item->type] = item->name;
+        best->value[item->type] = item->value;
+    }
 }
 
-/*
- * Compares two monsters based on hierarchy:
- * 1. Name (lexicographical).
- * 2. HP (integer comparison).
- * 3. Attack (integer comparison).
- * Returns < 0, > 0, or 0.
- */
-int compareMonsters(void* a, void* b) {
+//higher value wins, equal values go to the smaller name so the fold order does not matter
+static void bagBestCombine(void* agg, const void* other) {
+    BagBest* best = (BagBest*)agg;
+    const BagBest* with = (const BagBest*)other;
+
+    for (int t = 0; t < ITEM_TYPE_COUNT; t++) {
+        if (with->name[t] == NULL)
+            continue;
+        if (best->name[t] == NULL || with->value[t] > best->value[t]
+            || (with->value[t] == best->value[t] && strcmp(with->name[t], best->name[t]) < 0)) {
+            best->name[t] = with->name[t];
+            best->value[t] = with->value[t];
+        }
+    }
+}
 
-    Monster* monster1 = (Monster*)a;
-    Monster* monster2 = (Monster*)b;
+const BSTAggregate bagBestAggregate = { sizeof(BagBest), bagBestInit, bagBestCombine };
 
-    int res = strcmp(monster1->name, monster2->name);
-    if (res == 0)
-        res = monster1->hp - monster2->hp;
+// Copies the most valuable bag item of a type into best, returns 0 if there is none
+int bagBestItem(const Player* player, ItemType type, Item* best) {
+    const BagBest* all = (const BagBest*)bstAggregateAll(player->bag);
+    if (all == NULL || type < 0 || type >= ITEM_TYPE_COUNT || all->name[type] == NULL)
+        return 0;
 
-    if (res != 0)
-        return res;
+    best->name = (char*)all->name[type];
+    best->sortKey = nameSortKey(best->name);
+    best->type = type;
+    best->value = all->value[type];
+    return 1;
+}
 
-    return monster1->attack - monster2->attack;
+//BST callback around monsterOrder
+int compareMonsters(void* a, void* b) {
+    return monsterOrder((const Monster*)a, (const Monster*)b);
 }
 
 /*
@@ -319,10 +600,7 @@ void freeItem(void* data) {
     if (item == NULL)
         return;
 
-    //free feature
-    if (item->name != NULL)
-        free(item->name);
-
+    //the name is interned and belongs to the game
     free(item);
 }
 
@@ -333,10 +611,7 @@ void freeMonster(void* data) {
     if (mon == NULL)
         return;
 
-    if (mon->name != NULL) {
-        free(mon->name);
-    }
-
+    //the name is interned and belongs to the game
     free(mon);
 }
 
@@ -403,151 +678,512 @@ char* getItemTypeString(ItemType type) {
     }
 }
 
-// Main game loop handling player actions and game flow
+/*
+ * Step engine: every game action as one non-blocking call.
+ * The step functions never read input, print or exit; they validate the
+ * command, apply it to the state and describe the outcome in a StepOutput.
+ */
+
+static StepStatus stepAddRoom(GameState* g, const Command* cmd, StepOutput* out) {
+    int x = 0;
+    int y = 0;
+    if (g->rooms != NULL) {
+        Room* baseRoom = findRoomById(g, cmd->roomId);
+        if (baseRoom == NULL)
+            return STEP_INVALID_ROOM;
+
+        x = baseRoom->x;
+        y = baseRoom->y;
+        computeNewCoords(cmd->direction, &x, &y);
+    }
+
+    out->room = createRoomAt(g, x, y);
+    return out->room != NULL ? STEP_OK : STEP_ROOM_EXISTS;
+}
+
+static StepStatus stepAddMonster(GameState* g, const Command* cmd, StepOutput* out) {
+    Room* room = findRoomById(g, cmd->roomId);
+    if (room == NULL)
+        return STEP_INVALID_ROOM;
+    if (cmd->name == NULL)
+        return STEP_BAD_COMMAND;
+    if (room->monster != NULL)
+        return STEP_SLOT_TAKEN;
+
+    Monster* monster = (Monster*)gameAlloc(g, sizeof(Monster));
+    monster->name = copyName(g, cmd->name);
+    monster->sortKey = nameSortKey(monster->name);
+    monster->type = (MonsterType)cmd->kind;
+    monster->hp = cmd->hp;
+    monster->maxHp = cmd->hp;
+    monster->attack = cmd->attack;
+
+    touchRoom(g, room);
+    if (g->history != NULL)
+        checkpointCreated(g, monster, g->arena ? NULL : freeMonster);
+    room->monster = monster;
+    g->monstersRemaining++;
+    roomContentsChanged(g, room);
+
+    out->room = room;
+    out->monster = monster;
+    return STEP_OK;
+}
+
+static StepStatus stepAddItem(GameState* g, const Command* cmd, StepOutput* out) {
+    Room* room = findRoomById(g, cmd->roomId);
+    if (room == NULL)
+        return STEP_INVALID_ROOM;
+    if (cmd->name == NULL)
+        return STEP_BAD_COMMAND;
+    if (room->item != NULL)
+        return STEP_SLOT_TAKEN;
+
+    Item* item = (Item*)gameAlloc(g, sizeof(Item));
+    item->name = copyName(g, cmd->name);
+    item->sortKey = nameSortKey(item->name);
+    item->type = (ItemType)cmd->kind;
+    item->value = cmd->value;
+
+    touchRoom(g, room);
+    if (g->history != NULL)
+        checkpointCreated(g, item, g->arena ? NULL : freeItem);
+    room->item = item;
+    roomContentsChanged(g, room);
+
+    out->room = room;
+    out->item = item;
+    return STEP_OK;
+}
+
+static StepStatus stepInitPlayer(GameState* g, StepOutput* out) {
+    //the player always starts in the first room
+    Room* start = findRoomById(g, 0);
+    if (start == NULL)
+        return STEP_INVALID_ROOM;
+
+    //checkpoints hold versions of the old player's trees
+    gameDropCheckpoints(g);
+    if (g->player != NULL)
+        freePlayer(g->player, g->arena != NULL);
+    g->player = createPlayer(g);
+
+    g->player->maxHp = g->configMaxHp;
+    g->player->hp = g->configMaxHp;
+    g->player->currentRoom = start;
+    visitRoom(g, start);
+    g->player->baseAttack = g->configBaseAttack;
+
+    out->room = start;
+    return STEP_OK;
+}
+
+static StepStatus stepMove(GameState* g, const Command* cmd, StepOutput* out) {
+    Player* player = g->player;
+    Room* currRoom = player->currentRoom;
+
+    //leaving (or trying to leave) a room counts as having visited it
+    visitRoom(g, currRoom);
+    if (currRoom->monster != NULL)
+        return STEP_KILL_MONSTER_FIRST;
+
+    int targetX = currRoom->x;
+    int targetY = currRoom->y;
+    computeNewCoords(cmd->direction, &targetX, &targetY);
+    Room* targetRoom = findRoomByCoords(g, targetX, targetY);
+    if (targetRoom == NULL)
+        return STEP_NO_ROOM_THERE;
+
+    touchPlayer(g);
+    player->currentRoom = targetRoom;
+    out->room = targetRoom;
+    return checkWinCondition(g) ? STEP_WON : STEP_OK;
+}
+
+//smallest number of strikes (at least one) that takes hp to 0 or below, 0 if none ever does
+static long long strikesNeeded(long long hp, long long attack) {
+    if (attack >= hp)
+        return 1;
+    if (attack <= 0)
+        return 0;
+    return (hp + attack - 1) / attack;
+}
+
+/*
+ * Closed form of the round loop: the player needs ceil(monsterHp / attack)
+ * strikes, the monster ceil(playerHp / attack), and since the player strikes
+ * first they win ties. Non-positive hp or attack values follow what the loop
+ * would do, down to a dead monster still taking the opening strike.
+ */
+FightResult resolveFight(int playerHp, int playerAttack, int monsterHp, int monsterAttack) {
+    FightResult r = {0};
+
+    if (playerHp <= 0) {
+        //the loop body never runs, so the player loses whatever the monster's hp
+        r.playerWon = 0;
+    }
+    else {
+        long long playerNeeds = strikesNeeded(monsterHp, playerAttack);
+        long long monsterNeeds = strikesNeeded(playerHp, monsterAttack);
+
+        if (playerNeeds > 0 && (monsterNeeds == 0 || playerNeeds <= monsterNeeds)) {
+            r.playerWon = 1;
+            r.playerStrikes = playerNeeds;
+            r.monsterStrikes = playerNeeds - 1;
+        }
+        else if (monsterNeeds > 0) {
+            r.playerStrikes = monsterNeeds;
+            r.monsterStrikes = monsterNeeds;
+        }
+        else {
+            r.endless = 1;
+        }
+    }
+
+    r.playerHp = playerHp - r.monsterStrikes * monsterAttack;
+    r.monsterHp = monsterHp - r.playerStrikes * playerAttack;
+    return r;
+}
+
+#ifdef GAME_DEBUG
+// Reference round loop, used to cross-check resolveFight on short fights
+static FightResult loopFight(int playerHp, int playerAttack, int monsterHp, int monsterAttack) {
+    FightResult r = {0};
+    long long php = playerHp;
+    long long mhp = monsterHp;
+
+    while (php > 0) {
+        mhp -= playerAttack;
+        r.playerStrikes++;
+        if (mhp <= 0) {
+            r.playerWon = 1;
+            break;
+        }
+
+        php -= monsterAttack;
+        r.monsterStrikes++;
+    }
+    r.playerHp = php;
+    r.monsterHp = mhp;
+    return r;
+}
+#endif
+
+//stores a fight result back into an int hp field
+static int clampHp(long long hp) {
+    if (hp > INT_MAX)
+        return INT_MAX;
+    if (hp < INT_MIN)
+        return INT_MIN;
+    return (int)hp;
+}
+
+static StepStatus stepFight(GameState* g, StepOutput* out) {
+    Player* player = g->player;
+    Room* currRoom = player->currentRoom;
+    Monster* monster = currRoom->monster;
+    if (monster == NULL)
+        return STEP_NO_MONSTER;
+
+    out->monster = monster;
+    out->playerHpBefore = player->hp;
+    out->monsterHpBefore = monster->hp;
+
+    FightResult fight = resolveFight(player->hp, player->baseAttack, monster->hp, monster->attack);
+    if (fight.endless)
+        return STEP_STALEMATE;
+
+#ifdef GAME_DEBUG
+    if (fight.playerStrikes < 4096) {
+        FightResult check = loopFight(player->hp, player->baseAttack, monster->hp, monster->attack);
+        assert(check.playerWon == fight.playerWon);
+        assert(check.playerStrikes == fight.playerStrikes);
+        assert(check.monsterStrikes == fight.monsterStrikes);
+        assert(check.playerHp == fight.playerHp && check.monsterHp == fight.monsterHp);
+    }
+#endif
+
+    out->playerStrikes = fight.playerStrikes;
+    out->monsterStrikes = fight.monsterStrikes;
+    touchPlayer(g);
+    touchRoom(g, currRoom);
+    player->hp = clampHp(fight.playerHp);
+    monster->hp = clampHp(fight.monsterHp);
+    if (!fight.playerWon)
+        return STEP_PLAYER_DIED;
+
+    //a B-tree backed log keeps its own copy, report that one
+    out->monster = (Monster*)bstAdd(player->defeatedMonsters, monster);
+    currRoom->monster = NULL;
+    g->monstersRemaining--;
+    roomContentsChanged(g, currRoom);
+    return checkWinCondition(g) ? STEP_WON : STEP_OK;
+}
+
+static StepStatus stepPickup(GameState* g, StepOutput* out) {
+    Player* player = g->player;
+    Room* currRoom = player->currentRoom;
+
+    if (currRoom->monster != NULL)
+        return STEP_KILL_MONSTER_FIRST;
+    if (currRoom->item == NULL)
+        return STEP_NO_ITEM;
+    if (bstLookup(player->bag, currRoom->item) != NULL)
+        return STEP_DUPLICATE_ITEM;
+
+    touchPlayer(g);
+    touchRoom(g, currRoom);
+    out->item = (Item*)bstAdd(player->bag, currRoom->item);
+    currRoom->item = NULL;
+    roomContentsChanged(g, currRoom);
+    return STEP_OK;
+}
+
+/*
+ * Runs one command against the game state and fills out with what happened.
+ * Never blocks, prints or exits: a dead player is reported as
+ * STEP_PLAYER_DIED and the caller decides what to do with the game.
+ */
+StepStatus gameStep(GameState* g, const Command* cmd, StepOutput* out) {
+    memset(out, 0, sizeof(*out));
+    out->status = STEP_BAD_COMMAND;
+
+    if (g == NULL || cmd == NULL)
+        return out->status;
+
+    switch (cmd->type) {
+    case CMD_ADD_ROOM:
+        out->status = stepAddRoom(g, cmd, out);
+        return out->status;
+    case CMD_ADD_MONSTER:
+        out->status = stepAddMonster(g, cmd, out);
+        return out->status;
+    case CMD_ADD_ITEM:
+        out->status = stepAddItem(g, cmd, out);
+        return out->status;
+    case CMD_INIT_PLAYER:
+        out->status = stepInitPlayer(g, out);
+        return out->status;
+    default:
+        break;
+    }
+
+    //everything below acts through the player
+    if (g->player == NULL) {
+        out->status = STEP_NO_PLAYER;
+        return out->status;
+    }
+
+    switch (cmd->type) {
+    case CMD_MOVE:
+        out->status = stepMove(g, cmd, out);
+        break;
+    case CMD_FIGHT:
+        out->status = stepFight(g, out);
+        break;
+    case CMD_PICKUP:
+        out->status = stepPickup(g, out);
+        break;
+    case CMD_LIST_BAG:
+    case CMD_LIST_DEFEATED:
+        if (cmd->order < BST_PREORDER || cmd->order > BST_POSTORDER)
+            break;
+        out->tree = cmd->type == CMD_LIST_BAG ? g->player->bag : g->player->defeatedMonsters;
+        out->order = cmd->order;
+        out->status = STEP_OK;
+        break;
+    default:
+        break;
+    }
+    return out->status;
+}
+
+// Text the interactive front end prints for a step status
+const char* stepStatusMessage(StepStatus status) {
+    switch (status) {
+    case STEP_OK:                  return "";
+    case STEP_WON:                 return "All rooms explored. All monsters defeated.\n";
+    case STEP_PLAYER_DIED:         return "--- YOU DIED ---";
+    case STEP_INVALID_ROOM:        return "Invalid room\n";
+    case STEP_ROOM_EXISTS:         return "Room exists there\n";
+    case STEP_SLOT_TAKEN:          return "Slot taken\n";
+    case STEP_NO_PLAYER:           return "Init player first\n";
+    case STEP_NO_ROOM_THERE:       return "No room there\n";
+    case STEP_KILL_MONSTER_FIRST:  return "Kill monster first\n";
+    case STEP_NO_MONSTER:          return "No monster\n";
+    case STEP_NO_ITEM:             return "No item here\n";
+    case STEP_DUPLICATE_ITEM:      return "Duplicate item.\n";
+    case STEP_STALEMATE:           return "Neither of you can win this fight\n";
+    default:                       return "Invalid command\n";
+    }
+}
+
+// Replays the round by round combat log of a finished FIGHT step
+static void printFightLog(GameState* g, const StepOutput* out) {
+    long long attack = g->player->baseAttack;
+    long long monsterAttack = out->monster->attack;
+
+    //one line for the whole fight, however many rounds it took
+    if (g->quietFights) {
+        long long monsterHp = out->monsterHpBefore - out->playerStrikes * attack;
+        long long playerHp = out->playerHpBefore - out->monsterStrikes * monsterAttack;
+        printf("Fight: you strike %lld times, the monster %lld times. Monster HP: %lld, Your HP: %lld\n",
+            out->playerStrikes, out->monsterStrikes,
+            monsterHp > 0 ? monsterHp : 0, playerHp > 0 ? playerHp : 0);
+        return;
+    }
+
+    for (long long round = 1; round <= out->playerStrikes; round++) {
+        long long monsterHp = out->monsterHpBefore - round * attack;
+        printf("You deal %lld damage. Monster HP: %lld\n", attack, monsterHp > 0 ? monsterHp : 0);
+
+        if (round <= out->monsterStrikes) {
+            long long playerHp = out->playerHpBefore - round * monsterAttack;
+            printf("Monster deals %lld damage. Your HP: %lld\n",
+                monsterAttack, playerHp > 0 ? playerHp : 0);
+        }
+    }
+}
+
+// Main game loop: reads actions from the user and runs them through gameStep
 void playGame(GameState* g) {
+    if (g->player == NULL) {
+        printf("%s", stepStatusMessage(STEP_NO_PLAYER));
+        return;
+    }
+
     GameAction choice = 0;
     while (choice != QUIT) {
+        fbBegin(&g->frame);
         displayGameStatus(g);
         displayRoomAndPlayerStatus(g);
-        printGameOptions();
+        printGameOptions(g);
+        PROF_START(flush);
+        fbFlush(&g->frame, stdout);
+        PROF_STOP(flush, PROF_FRAME_FLUSH);
         
         choice = (GameAction)getInt(NULL, g);
-        Player* player = g->player;
-        Room* currRoom = player->currentRoom;
-        Monster* monster = currRoom->monster;
-        
+        Command cmd = { .type = CMD_MOVE };
+        StepOutput out;
+
         switch (choice)
         {
             case MOVE:
             {
-                currRoom->visited = 1;
-                
-                if (monster) {
-                    printf("Kill monster first\n");
-                    break;
-                }
-                
-                int roomDirec = getInt(stringChooseDirection(), g);
-
-                int targetX = currRoom->x;
-                int targetY = currRoom->y;
-                computeNewCoords(roomDirec, &targetX, &targetY);
-                Room* targetRoom = findRoomByCoords(g->rooms, targetX, targetY);
-                
-                if (!targetRoom) {
-                    printf("No room there\n");
-                    break;
-                }
-                
-                player->currentRoom = targetRoom;
-                if (checkWinCondition(g))
-                    handleWin(g);
-                
+                //the direction is only asked for when the way is free
+                if (g->player->currentRoom->monster == NULL)
+                    cmd.direction = (Direction)getInt(stringChooseDirection(), g);
                 break;
             }
 
             case FIGHT:
-            {
-                int playerWon = 0;
-                if (monster == NULL) {
-                    printf("No monster\n");
-                    break;
-                }
-                while (player->hp > 0) {
-                    monster->hp = monster->hp - player->baseAttack;
-                    printf("You deal %d damage. Monster HP: %d\n", 
-                        player->baseAttack, monster->hp > 0 ? monster->hp : 0);
-                    if (monster->hp <= 0) {
-                        playerWon = 1;
-                        break;
-                    }
-                    else {
-                        player->hp = player->hp - monster->attack;
-                        printf("Monster deals %d damage. Your HP: %d\n", 
-                            monster->attack, player->hp > 0 ? player->hp : 0);
-                    }
-
-                }
-                if (playerWon == 0) {
-                    freeGame(g);
-                    printf("--- YOU DIED ---");
-                    exit(0);
-                }
-                printf("Monster defeated!\n");
-                bstInsert(player->defeatedMonsters, monster, compareMonsters);
-                currRoom->monster = NULL;
-                if (checkWinCondition(g)) {
-                    handleWin(g);
-                }
+                cmd.type = CMD_FIGHT;
                 break;
-            }
 
             case PICKUP:
-            {
-                if (monster) {
-                    printf("Kill monster first\n");
-                    break;
-                }
-
-                if (currRoom->item == NULL) {
-                    printf("No item here\n");
-                    break;
-                }
-                void* found = bstFind(player->bag, currRoom->item, compareItems);
-                if (found) {
-                    printf("Duplicate item.\n");
-                    break;
-                }
-                bstInsert(player->bag, currRoom->item, compareItems);
-                printf("picked up %s", currRoom->item->name);
-                currRoom->item = NULL;
-
+                cmd.type = CMD_PICKUP;
                 break;
-            }
 
             case BAG:
             {
                 printf("=== INVENTORY ===\n");
-                printOrderOptions(g, player->bag, printItem);
-                break;
+                printOrderOptions(g, g->player->bag, printItem);
+                continue;
             }
 
             case DEFEATED:
             {
                 printf("=== DEFEATED MONSTERS ===\n");
-                printOrderOptions(g, player->defeatedMonsters, printMonster);
-                break;
+                printOrderOptions(g, g->player->defeatedMonsters, printMonster);
+                continue;
+            }
+
+            case CHECKPOINT:
+            {
+                int id = gameCheckpoint(g);
+                if (id >= 0)
+                    printf("Checkpoint %d saved\n", id);
+                continue;
+            }
+
+            case UNDO:
+            {
+                //back to the latest checkpoint, which stays for the next undo
+                int id = g->history ? g->history->count - 1 : -1;
+                if (gameRestore(g, id))
+                    printf("Back to checkpoint %d\n", id);
+                else if (g->history != NULL)
+                    printf("No checkpoint\n");
+                continue;
             }
-        }     
+
+#ifdef GAME_PROFILE
+            case PROFILE_DUMP:
+                profDump(stderr);
+                continue;
+#endif
+
+            default:
+                continue;
+        }
+
+        PROF_START(action);
+        StepStatus status = gameStep(g, &cmd, &out);
+
+        if (cmd.type == CMD_FIGHT && out.monster != NULL && status != STEP_STALEMATE)
+            printFightLog(g, &out);
+        PROF_STOP(action, PROF_ACTION_MOVE + (choice - MOVE));
+
+        switch (status) {
+        case STEP_OK:
+            if (cmd.type == CMD_FIGHT)
+                printf("Monster defeated!\n");
+            else if (cmd.type == CMD_PICKUP)
+                printf("picked up %s", out.item->name);
+            break;
+
+        case STEP_WON:
+            if (cmd.type == CMD_FIGHT)
+                printf("Monster defeated!\n");
+            handleWin(g);
+            break;
+
+        case STEP_PLAYER_DIED:
+            freeGame(g);
+            printf("--- YOU DIED ---");
+            exit(0);
+
+        default:
+            printf("%s", stepStatusMessage(status));
+            break;
+        }
     }
 }
 
-// Prints the main game action menu
-void printGameOptions() {
-    printf("1.Move 2.Fight 3.Pickup 4.Bag 5.Defeated 6.Quit\n");
+// Adds the main game action menu to the frame
+void printGameOptions(GameState* g) {
+    fbAppendLiteral(&g->frame, "1.Move 2.Fight 3.Pickup 4.Bag 5.Defeated 6.Quit\n");
+    if (g->history != NULL)
+        fbAppendLiteral(&g->frame, "7.Checkpoint 8.Undo\n");
 }
 
 // Finds and returns a room by its X and Y coordinates
-Room* findRoomByCoords(Room* head, int x, int y) {
-    for (Room* r = head; r != NULL; r = r->next) {
-        if (r->x == x && r->y == y) {
-            return r;
-        }
-    }
-    return NULL;
+Room* findRoomByCoords(GameState* g, int x, int y) {
+    return roomIndexFind(&g->roomIndex, x, y);
 }
 
 /*frees the memory of player except of room
 (that free game state will do)*/
-static void freePlayer(Player* player) {
+static void freePlayer(Player* player, int inArena) {
 
     //safety check
     if (player == NULL)
         return;
 
-    bstFree(player->bag, freeItem);
-    bstFree(player->defeatedMonsters, freeMonster);
-    free(player);
+    bstDestroy(player->bag);
+    bstDestroy(player->defeatedMonsters);
+    if (!inArena)
+        free(player);
 }
 
 // Frees a room and its associated monster and item
@@ -570,23 +1206,75 @@ static void freeGameState(GameState* game) {
     if (!game)
         return;
 
+    if (game->showStats)
+        roomMemoryReport(game, stderr);
+
+    //the journal holds tree versions, so it goes before the trees
+    checkpointFree(game);
+
     //free player
     if (game->player)
-        freePlayer(game->player);
+        freePlayer(game->player, game->arena != NULL);
 
-    Room* iterRoom = game->rooms;
-    while (iterRoom != NULL) {
-        Room* nextRoom = iterRoom->next;
-        freeRoom(iterRoom);
-        iterRoom = nextRoom;
+    //walk the id table instead of chasing next pointers
+    if (game->arena == NULL) {
+        for (int i = 0; i < game->roomCount; i++)
+            freeRoom(game->roomTable[i]);
     }
 
-    free(game);
+    free(game->roomTable);
+    roomIndexFree(&game->roomIndex);
+    roomStoreFree(&game->roomStore);
+
+    if (game->showStats)
+        fbReport(&game->frame, stderr);
+    fbFree(&game->frame);
+    freeMapCache(&game->mapCache);
+
+    //rooms, monsters, items, names and tree nodes all go in one sweep
+    if (game->arena != NULL) {
+        if (game->showStats)
+            arenaReport(game->arena, stderr);
+        arenaFree(game->arena);
+        game->arena = NULL;
+    }
+    unmapFile(&game->worldFile);
+    nameTableFree(&game->names);
+
+    //the state itself belongs to the caller, reset it so it can be reused
+    game->rooms = NULL;
+    game->lastRoom = NULL;
+    game->roomTable = NULL;
+    game->roomCapacity = 0;
+    game->player = NULL;
+    game->roomCount = 0;
+    game->unvisitedRooms = 0;
+    game->monstersRemaining = 0;
+}
+
+/*
+ * Memory per room: the Room objects with their id table and index slots,
+ * and the flag bitsets kept next to them, first per room in use and then
+ * with the spare capacity of every array counted in.
+ */
+static void roomMemoryReport(GameState* g, FILE* out) {
+    if (g->roomCount == 0)
+        return;
+
+    double objects = sizeof(Room) + sizeof(Room*) + sizeof(RoomSlot);
+    size_t objectsReserved = (size_t)g->roomCount * sizeof(Room) + (size_t)g->roomCapacity * sizeof(Room*)
+        + (size_t)g->roomIndex.capacity * sizeof(RoomSlot);
+    fprintf(out, "rooms: %d rooms, Room objects %.1f bytes/room (%.1f reserved), "
+        "flag bitsets +%.3f bytes/room (%.3f reserved)\n",
+        g->roomCount, objects, (double)objectsReserved / g->roomCount,
+        3.0 / 8, (double)roomStoreBytes(&g->roomStore) / g->roomCount);
 }
 
 // Wrapper function to free the entire game state
 void freeGame(GameState* g) {
+    PROF_START(teardown);
     freeGameState(g);
+    PROF_STOP(teardown, PROF_TEARDOWN);
 }
 
 // Returns a prompt string for choosing movement direction
@@ -598,8 +1286,13 @@ char* stringChooseDirection()
 // Safely reads an integer input and exits cleanly on failure
 int getInt(char* prompt, GameState* gameState) {
     int outNum = 0;
-    if (getIntInternal(prompt, &outNum) == 0)
+    PROF_START(input);
+    int ok = getIntInternal(prompt, &outNum);
+    PROF_STOP(input, PROF_INPUT);
+    if (ok == 0)
     {
+        if (gameState->onSessionEnd != NULL)
+            gameState->onSessionEnd(gameState);
         freeGame(gameState);
         exit(0);
     }
@@ -608,28 +1301,50 @@ int getInt(char* prompt, GameState* gameState) {
 
 }
 
-// Prompts for BST traversal order and prints the tree accordingly
+typedef struct {
+    void (*print)(void*);
+} PrintVisit;
+
+static void printVisited(void* data, void* ctx) {
+    ((PrintVisit*)ctx)->print(data);
+}
+
+// Prompts for BST traversal order and streams the tree accordingly
 static void printOrderOptions(GameState* g, BST* tree, void (*printFunc)(void*)) {
 
     Order orderChoice = (Order)getInt("1.Preorder 2.Inorder 3.Postorder\n", g);
+    Command cmd = { .type = tree == g->player->bag ? CMD_LIST_BAG : CMD_LIST_DEFEATED };
+    StepOutput out;
 
     switch (orderChoice) {
     case PREORDER:
-        bstPreorder(tree, printFunc);
+        cmd.order = BST_PREORDER;
         break;
 
     case INORDER:
-        bstInorder(tree, printFunc);
+        cmd.order = BST_INORDER;
         break;
 
     case POSTORDER:
-        bstPostorder(tree, printFunc);
+        cmd.order = BST_POSTORDER;
         break;
+
+    default:
+        return;
     }
+
+    PROF_START(list);
+    if (gameStep(g, &cmd, &out) != STEP_OK)
+        return;
+
+    PrintVisit visit = { printFunc };
+    bstForEach(out.tree, out.order, printVisited, &visit);
+    PROF_STOP(list, cmd.type == CMD_LIST_BAG ? PROF_ACTION_BAG : PROF_ACTION_DEFEATED);
 }
 
-// Checks if all rooms were visited and all monsters defeated
-static int checkWinCondition(GameState* g) {
+#ifdef GAME_DEBUG
+// Full world scan, only used to cross-check the live counters
+static int scanWinCondition(GameState* g) {
     Room* iterRoom = g->rooms;
     while (iterRoom != NULL) {
         if (iterRoom->monster || iterRoom->visited == 0)
@@ -639,6 +1354,59 @@ static int checkWinCondition(GameState* g) {
     }
     return 1;
 }
+#endif
+
+// Checks if all rooms were visited and all monsters defeated
+static int checkWinCondition(GameState* g) {
+    PROF_START(win);
+    int won = g->unvisitedRooms == 0 && g->monstersRemaining == 0;
+    PROF_STOP(win, PROF_WIN_CHECK);
+
+#ifdef GAME_DEBUG
+    assert(won == scanWinCondition(g));
+    assert(won == roomStoreAllCleared(&g->roomStore));
+#endif
+
+    return won;
+}
+
+// Allocates a game object from the arena when the game uses one
+static void* gameAlloc(GameState* g, size_t size) {
+    if (g->arena != NULL)
+        return arenaAlloc(g->arena, size);
+
+    void* ptr = malloc(size);
+    if (ptr == NULL)
+        exit(1);
+    return ptr;
+}
+
+// Returns the game's interned copy of a name (stored in the arena when the game uses one)
+static char* copyName(GameState* g, const char* name) {
+    return (char*)internName(&g->names, name, g->arena);
+}
+
+// Marks a room as visited and keeps the unvisited counter in sync
+static void visitRoom(GameState* g, Room* room) {
+    if (room->visited)
+        return;
+
+    touchRoom(g, room);
+    room->visited = 1;
+    roomStoreSet(g->roomStore.visited, room->id, 1);
+    g->unvisitedRooms--;
+}
+
+// Journal hooks, free when checkpoints are off
+static void touchRoom(GameState* g, Room* room) {
+    if (g->history != NULL)
+        checkpointTouchRoom(g, room);
+}
+
+static void touchPlayer(GameState* g) {
+    if (g->history != NULL)
+        checkpointTouchPlayer(g);
+}
 
 // Handles game completion and victory state
 static void handleWin(GameState* g) {
@@ -3,26 +3,62 @@
 #define GAME_H
 
 
+#include "arena.h"
 #include "bst.h"
+#include "intern.h"
+#include "render.h"
+#include "roomindex.h"
+#include "roomstore.h"
+#include "utils.h"
 
 typedef enum { ARMOR, SWORD } ItemType;
+#define ITEM_TYPE_COUNT 2
 typedef enum { PHANTOM, SPIDER, DEMON, GOLEM, COBRA } MonsterType;
 typedef enum { UP = 0, DOWN = 1, LEFT = 2, RIGHT = 3 } Direction;
 
 typedef struct Item {
-    char* name;
+    char* name;             // interned, owned by the game's name table
+    unsigned long long sortKey;  // nameSortKey(name), compared before the name
     ItemType type;
     int value;
 } Item;
 
 typedef struct Monster {
-    char* name;
+    char* name;             // interned, owned by the game's name table
+    unsigned long long sortKey;  // nameSortKey(name), compared before the name
     MonsterType type;
     int hp;
     int maxHp;
     int attack;
 } Monster;
 
+/*
+ * Item order: name, then value, then type. Returns < 0, > 0, or 0 if
+ * identical. Inline so the typed trees compare without a call.
+ */
+static inline int itemOrder(const Item* item1, const Item* item2) {
+    int res = compareNames(item1->name, item1->sortKey, item2->name, item2->sortKey);
+    if (res == 0)
+        res = (item1->value > item2->value) - (item1->value < item2->value);
+
+    if (res != 0)
+        return res;
+
+    return (item1->type > item2->type) - (item1->type < item2->type);
+}
+
+//Monster order: name, then hp, then attack
+static inline int monsterOrder(const Monster* monster1, const Monster* monster2) {
+    int res = compareNames(monster1->name, monster1->sortKey, monster2->name, monster2->sortKey);
+    if (res == 0)
+        res = (monster1->hp > monster2->hp) - (monster1->hp < monster2->hp);
+
+    if (res != 0)
+        return res;
+
+    return (monster1->attack > monster2->attack) - (monster1->attack < monster2->attack);
+}
+
 typedef struct Room {
     int id;
     int x, y;
@@ -41,14 +77,129 @@ typedef struct Player {
     Room* currentRoom;
 } Player;
 
+/*
+ * Persistent map state: one contiguous grid of room ids that only grows,
+ * plus the rendered map and legend text, reused while nothing changes.
+ * A world whose bounding box would need more than GRID_MAX_CELLS cells
+ * drops the grid and draws the map from the room index instead.
+ */
 typedef struct {
+    int* cells;             // cellsWide * cellsHigh room ids, -1 for empty
+    long long originX, originY;  // world coordinates of cells[0]
+    int cellsWide, cellsHigh;
+    int gridOff;            // bounding box over the cap, no grid any more
+    int minX, maxX, minY, maxY;  // bounds of the rooms (always include 0,0)
+    FrameBuffer mapText;
+    int mapDirty;
+    FrameBuffer legendText;
+    size_t* legendSlots;    // per room id, offset of its monster status char
+    int legendRooms;        // rooms already written to legendText
+    int legendCapacity;
+} MapCache;
+
+struct CheckpointLog;
+
+typedef struct GameState {
     Room* rooms;
+    Room* lastRoom;
+    Room** roomTable;     // rooms indexed by id, ids are dense from 0
+    int roomCapacity;
+    RoomIndex roomIndex;
+    RoomStore roomStore;  // visited/monster/item bit of every room, for whole-world passes
     Player* player;
     int roomCount;
+    int unvisitedRooms;   // live win-condition counters
+    int monstersRemaining;
     int configMaxHp;
     int configBaseAttack;
+    Arena* arena;         // optional, when set all game objects live in it
+    FrameBuffer frame;    // each turn's screen is formatted here and written at once
+    MapCache mapCache;
+    int showStats;        // print allocation/render statistics on teardown
+    int quietFights;      // print one summary line per fight instead of every round
+    int useBTree;         // bag and monster log use the B-tree backend
+    struct CheckpointLog* history;  // undo journal, NULL unless checkpoints are enabled
+    MappedFile worldFile; // loaded world, names point into it until teardown
+    NameTable names;      // every monster and item name, stored once
+    void (*onSessionEnd)(struct GameState* g);  // optional, runs on menu Exit and when getInt hits EOF
 } GameState;
 
+/*
+ * Command driven engine: gameStep performs exactly one action, never reads
+ * stdin, never prints and never exits. The interactive menu is an adapter
+ * that gathers input, builds a Command and prints the StepOutput.
+ */
+typedef enum {
+    CMD_ADD_ROOM,       // roomId = room to attach to (ignored for the first room), direction
+    CMD_ADD_MONSTER,    // roomId, name, kind (MonsterType), hp, attack
+    CMD_ADD_ITEM,       // roomId, name, kind (ItemType), value
+    CMD_INIT_PLAYER,
+    CMD_MOVE,           // direction
+    CMD_FIGHT,
+    CMD_PICKUP,
+    CMD_LIST_BAG,       // order
+    CMD_LIST_DEFEATED   // order
+} CommandType;
+
+typedef struct {
+    CommandType type;
+    int roomId;
+    Direction direction;
+    const char* name;   // copied by the engine
+    int kind;
+    int hp;
+    int attack;
+    int value;
+    BSTOrder order;
+} Command;
+
+typedef enum {
+    STEP_OK,
+    STEP_WON,               // the action completed and the game is won
+    STEP_PLAYER_DIED,
+    STEP_INVALID_ROOM,
+    STEP_ROOM_EXISTS,
+    STEP_SLOT_TAKEN,        // the room already has a monster/item
+    STEP_NO_PLAYER,
+    STEP_NO_ROOM_THERE,
+    STEP_KILL_MONSTER_FIRST,
+    STEP_NO_MONSTER,
+    STEP_NO_ITEM,
+    STEP_DUPLICATE_ITEM,
+    STEP_STALEMATE,         // neither side can hurt the other, nothing changed
+    STEP_BAD_COMMAND
+} StepStatus;
+
+typedef struct {
+    StepStatus status;
+    Room* room;             // room created, entered or acted in
+    Monster* monster;       // monster added or fought
+    Item* item;             // item added or picked up
+    int playerHpBefore;     // FIGHT: both sides before the first strike
+    int monsterHpBefore;
+    long long playerStrikes;    // FIGHT: strikes landed by each side
+    long long monsterStrikes;
+    BST* tree;              // LIST_*: tree to stream in the requested order
+    BSTOrder order;
+} StepOutput;
+
+/*
+ * Outcome of a fight where the player strikes first and the sides alternate
+ * until one of them drops to 0 hp, computed without playing the rounds.
+ */
+typedef struct {
+    int playerWon;
+    int endless;            // nobody can ever win, the round loop would not end
+    long long playerStrikes;
+    long long monsterStrikes;
+    long long playerHp;     // hp after the fight (may be negative, like the loop)
+    long long monsterHp;
+} FightResult;
+
+FightResult resolveFight(int playerHp, int playerAttack, int monsterHp, int monsterAttack);
+StepStatus gameStep(GameState* g, const Command* cmd, StepOutput* out);
+const char* stepStatusMessage(StepStatus status);
+
 // Monster functions
 void freeMonster(void* data);
 int compareMonsters(void* a, void* b);
@@ -58,26 +209,41 @@ void printMonster(void* data);
 void freeItem(void* data);
 int compareItems(void* a, void* b);
 void printItem(void* data);
+Item itemProbe(const char* name);
+
+/*
+ * Bag aggregate: the best value of each item type and the name of the item
+ * holding it (ties go to the smaller name), so the best item is known in O(1).
+ */
+typedef struct {
+    const char* name[ITEM_TYPE_COUNT];     // NULL when the bag has no item of the type
+    int value[ITEM_TYPE_COUNT];
+} BagBest;
+
+extern const BSTAggregate bagBestAggregate;
+int bagBestItem(const Player* player, ItemType type, Item* best);
 
 // Game functions
 void addRoom(GameState* g);
 void initPlayer(GameState* g);
+Player* createPlayer(GameState* g);
 void playGame(GameState* g);
 void freeGame(GameState* g);
+Room* createRoomAt(GameState* g, int x, int y);
+int registerRoom(GameState* g, Room* room);
+void reserveRooms(GameState* g, int count);
+int getInt(char* prompt, GameState* gameState);
 
 //helper function
-void printLegend(Room* rooms);
+void printLegend(GameState* g);
 void addMonsterFunc(Room* room, GameState* g);
 char* getItemTypeString(ItemType type);
 char* getMonsterTypeString(MonsterType monType);
 void addItemFunc(Room* room, GameState* g);
-Room* findRoomByCoords(Room* head, int x, int y);
-void printGameOptions();
+Room* findRoomByCoords(GameState* g, int x, int y);
+void roomContentsChanged(GameState* g, Room* room);
+void printGameOptions(GameState* g);
+void displayGameStatus(GameState* g);
 void displayRoomAndPlayerStatus(GameState* g);
 char* stringChooseDirection();
-
-//free functions
-static void freeRoom(Room* room);
-static void freePlayer(Player* player);
-static void freeGameState(GameState* game);
 #endif
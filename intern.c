@@ -0,0 +1,107 @@
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+#include "prof.h"
+
+#define INTERN_MIN_CAPACITY 16
+#define INTERN_STRING_CHUNK 4096
+
+//FNV-1a over the bytes of the name
+static unsigned int hashName(const char* name) {
+    unsigned int h = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)name; *p; p++) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+//doubles the table, names keep their slots' hashes
+static void growTable(NameTable* table) {
+    int newCapacity = table->capacity ? table->capacity * 2 : INTERN_MIN_CAPACITY;
+    InternSlot* newSlots = (InternSlot*)calloc((size_t)newCapacity, sizeof(InternSlot));
+    if (newSlots == NULL)
+        exit(1);
+
+    unsigned int mask = (unsigned int)newCapacity - 1;
+    for (int i = 0; i < table->capacity; i++) {
+        InternSlot* s = &table->slots[i];
+        if (s->name == NULL)
+            continue;
+
+        unsigned int j = s->hash & mask;
+        while (newSlots[j].name != NULL)
+            j = (j + 1) & mask;
+        newSlots[j] = *s;
+    }
+
+    free(table->slots);
+    table->slots = newSlots;
+    table->capacity = newCapacity;
+}
+
+/*
+ * Returns the canonical copy of name, adding it when it is new. With copy
+ * set the bytes are duplicated into storage (or the table's own arena),
+ * otherwise name itself becomes canonical and must outlive the table.
+ */
+static const char* intern(NameTable* table, const char* name, Arena* storage, int copy) {
+    //keep the load factor at most 1/2
+    if ((table->count + 1) * 2 > table->capacity)
+        growTable(table);
+
+    unsigned int hash = hashName(name);
+    unsigned int mask = (unsigned int)table->capacity - 1;
+    unsigned int i = hash & mask;
+
+    while (table->slots[i].name != NULL) {
+        if (table->slots[i].hash == hash && strcmp(table->slots[i].name, name) == 0)
+            return table->slots[i].name;
+        i = (i + 1) & mask;
+    }
+
+    if (copy) {
+        if (storage == NULL) {
+            if (table->strings == NULL)
+                table->strings = createArena(INTERN_STRING_CHUNK);
+            storage = table->strings;
+        }
+        name = arenaStrdup(storage, name);
+    }
+
+    table->slots[i].name = name;
+    table->slots[i].hash = hash;
+    table->count++;
+    return name;
+}
+
+// Interns a copy of name, storage NULL keeps the bytes in the table's arena
+const char* internName(NameTable* table, const char* name, Arena* storage) {
+    return intern(table, name, storage, 1);
+}
+
+// Interns name without copying it, for names in memory that outlives the table
+const char* internNameInPlace(NameTable* table, const char* name) {
+    return intern(table, name, NULL, 0);
+}
+
+/*
+ * First 8 bytes of the name packed big endian, zero padded. Comparing two
+ * keys as integers orders names exactly like strcmp does on those bytes.
+ */
+unsigned long long nameSortKey(const char* name) {
+    unsigned long long key = 0;
+    int ended = 0;
+    for (int i = 0; i < 8; i++) {
+        ended = ended || name[i] == '\0';
+        key = (key << 8) | (ended ? 0u : (unsigned char)name[i]);
+    }
+    return key;
+}
+
+void nameTableFree(NameTable* table) {
+    free(table->slots);
+    if (table->strings != NULL)
+        arenaFree(table->strings);
+    memset(table, 0, sizeof(*table));
+}
@@ -0,0 +1,44 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <string.h>
+#include "arena.h"
+
+//one interned name, the hash is kept so probing rarely touches the string
+typedef struct {
+    const char* name;
+    unsigned int hash;
+} InternSlot;
+
+/*
+ * Name interning table: every distinct name is stored once and all objects
+ * with that name share the canonical pointer. Capacity is a power of two,
+ * copied names live in the table's own string arena (or the game arena).
+ */
+typedef struct {
+    InternSlot* slots;
+    int capacity;
+    int count;
+    Arena* strings;         // lazily created when no shared arena is passed
+} NameTable;
+
+const char* internName(NameTable* table, const char* name, Arena* storage);
+const char* internNameInPlace(NameTable* table, const char* name);
+unsigned long long nameSortKey(const char* name);
+void nameTableFree(NameTable* table);
+
+/*
+ * Orders two names like strcmp. The packed first 8 bytes settle most pairs;
+ * equal keys with a NUL inside mean equal names, interned names that share
+ * a pointer are equal, and only long names with a common prefix walk the rest.
+ */
+static inline int compareNames(const char* a, unsigned long long keyA,
+    const char* b, unsigned long long keyB) {
+    if (keyA != keyB)
+        return keyA < keyB ? -1 : 1;
+    if (a == b || (keyA & 0xFF) == 0)
+        return 0;
+    return strcmp(a + 8, b + 8);
+}
+
+#endif
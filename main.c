@@ -2,14 +2,80 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include "checkpoint.h"
+#include "combat.h"
 #include "game.h"
+#include "prof.h"
+#include "sim.h"
+#include "snapshot.h"
 #include "utils.h"
+#include "world.h"
 
 typedef void (*ActionFunc)(GameState*);
 
+static const char* profilePath = NULL;
+static const char* savePath = NULL;
+
+//runs on every exit path, including the win and death exits inside playGame
+static void dumpProfile(void) {
+    if (!profDumpToFile(profilePath))
+        fprintf(stderr, "Could not write profile to %s\n", profilePath);
+}
+
+/*
+ * Writes the session so it can be picked up again with --restore. Runs when
+ * the menu's Exit is chosen and when input runs out, so piped sessions are
+ * saved too; a game that ended in a win or death is over and is not saved.
+ */
+static void saveSession(GameState* game) {
+    if (!saveSnapshot(game, savePath))
+        printf("Could not save snapshot to %s\n", savePath);
+}
+
+//parses "from:to:step", a single number is a one value range
+static int parseRange(const char* text, int range[3]) {
+    if (sscanf(text, "%d:%d:%d", &range[0], &range[1], &range[2]) == 3)
+        return range[2] > 0 && range[0] <= range[1];
+    if (sscanf(text, "%d", &range[0]) == 1) {
+        range[1] = range[0];
+        range[2] = 1;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Prints the win matrix of a player config grid against the monsters of the
+ * loaded world, or of a generated one when nothing was loaded.
+ */
+static void runSweep(GameState* game, const SimConfig* sim, const int hpRange[3], const int attackRange[3]) {
+    MonsterSoA monsters = {0};
+    PlayerBatch players;
+
+    if (monsterSoACollect(&monsters, game) == 0) {
+        GameState generated = {0};
+        unsigned long long rng = sim->seed;
+        simGenerateWorld(&generated, sim, &rng);
+        monsterSoACollect(&monsters, &generated);
+        freeGame(&generated);
+    }
+
+    int columns = playerBatchGrid(&players, hpRange[0], hpRange[1], hpRange[2],
+        attackRange[0], attackRange[1], attackRange[2]);
+    if (columns > 0)
+        combatPrintMatrix(&monsters, &players, columns, stdout);
+
+    playerBatchFree(&players);
+    monsterSoAFree(&monsters);
+}
+
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        printf("Usage: %s <player_hp> <base_attack>\n", argv[0]);
+    if (argc < 3) {
+        printf("Usage: %s <player_hp> <base_attack> [--arena] [--btree] [--undo] [--stats] [--quiet] [--profile <json>] [--load <world>]"
+            " [--restore <snapshot>] [--save <snapshot>]"
+            " [--sim <games> [--threads <n>] [--rooms <n>] [--seed <n>]]"
+            " [--sweep-hp <from:to:step>] [--sweep-atk <from:to:step>]\n", argv[0]);
         return 1;
     }
 
@@ -17,16 +83,119 @@ int main(int argc, char* argv[]) {
     game.configMaxHp = atoi(argv[1]);
     game.configBaseAttack = atoi(argv[2]);
 
+    const char* worldPath = NULL;
+    const char* restorePath = NULL;
+    SimConfig sim;
+    simDefaultConfig(&sim);
+    sim.games = 0;
+    int sweep = 0;
+    int undo = 0;
+    int hpRange[3] = { game.configMaxHp, game.configMaxHp, 1 };
+    int attackRange[3] = { game.configBaseAttack, game.configBaseAttack, 1 };
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--arena") == 0 && game.arena == NULL) {
+            game.arena = createArena(0);
+        }
+        else if (strcmp(argv[i], "--btree") == 0) {
+            game.useBTree = 1;
+        }
+        else if (strcmp(argv[i], "--undo") == 0) {
+            undo = 1;
+        }
+        else if (strcmp(argv[i], "--stats") == 0) {
+            game.showStats = 1;
+        }
+        else if (strcmp(argv[i], "--quiet") == 0) {
+            game.quietFights = 1;
+        }
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profilePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+            worldPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc) {
+            restorePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+            savePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--sim") == 0 && i + 1 < argc) {
+            sim.games = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            sim.threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--rooms") == 0 && i + 1 < argc) {
+            sim.rooms = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            sim.seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--sweep-hp") == 0 && i + 1 < argc && parseRange(argv[i + 1], hpRange)) {
+            sweep = 1;
+            i++;
+        }
+        else if (strcmp(argv[i], "--sweep-atk") == 0 && i + 1 < argc && parseRange(argv[i + 1], attackRange)) {
+            sweep = 1;
+            i++;
+        }
+        else {
+            printf("Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (profilePath != NULL)
+        atexit(dumpProfile);
+
+    //headless balancing run, the interactive menu is skipped entirely
+    if (sim.games > 0) {
+        SimResult result;
+        sim.maxHp = game.configMaxHp;
+        sim.baseAttack = game.configBaseAttack;
+        sim.useArena = game.arena != NULL;
+        sim.useBTree = game.useBTree;
+        runSimulations(&sim, &result);
+        simReport(&result, stdout);
+        freeGame(&game);
+        return 0;
+    }
+
+    //before any player exists, so the bag and monster log are made persistent
+    if (undo && !checkpointEnable(&game)) {
+        printf("--undo does not work with --btree\n");
+        freeGame(&game);
+        return 1;
+    }
+
+    if (worldPath != NULL && !loadWorld(&game, worldPath))
+        return 1;
+    if (restorePath != NULL && !loadSnapshot(&game, restorePath))
+        return 1;
+
+    if (sweep) {
+        runSweep(&game, &sim, hpRange, attackRange);
+        freeGame(&game);
+        return 0;
+    }
+
+    if (savePath != NULL)
+        game.onSessionEnd = saveSession;
+
     ActionFunc actions[] = {NULL, addRoom, initPlayer, playGame};
 
     int running = 1;
     while (running) {
         printf("\n=== MENU ===\n1.Add Room\n2.Init Player\n3.Play\n4.Exit\n");
-        int c = getInt("Choice: ");
+        int c = getInt("Choice: ", &game);
         if (c == 4) running = 0;
         else if (c >= 1 && c <= 3) actions[c](&game);
     }
 
+    if (game.onSessionEnd != NULL)
+        game.onSessionEnd(&game);
+
     freeGame(&game);
     return 0;
 }
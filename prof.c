@@ -0,0 +1,128 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROF_IMPLEMENTATION
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "prof.h"
+
+#if defined(_MSC_VER)
+#define PROF_THREAD_LOCAL __declspec(thread)
+#else
+#define PROF_THREAD_LOCAL _Thread_local
+#endif
+
+#ifdef GAME_PROFILE
+static const char* const slotNames[PROF_SLOT_COUNT] = {
+    "input", "move", "fight", "pickup", "bag", "defeated", "add_room", "init_player",
+    "display_map", "print_legend", "frame_flush", "win_check", "bst_add", "bst_lookup",
+    "restore", "teardown"
+};
+#endif
+
+static PROF_THREAD_LOCAL ProfTimer timers[PROF_SLOT_COUNT];
+static PROF_THREAD_LOCAL ProfAllocs allocs;
+
+//adds one measurement to the slot's totals and histogram
+void profRecord(ProfSlot slot, long long ns) {
+    ProfTimer* t = &timers[slot];
+    if (ns < 0)
+        ns = 0;
+
+    if (t->count == 0 || ns < t->minNs)
+        t->minNs = ns;
+    if (ns > t->maxNs)
+        t->maxNs = ns;
+    t->count++;
+    t->totalNs += ns;
+
+    int bucket = 0;
+    while (bucket < PROF_BUCKETS - 1 && (ns >> (bucket + 1)) != 0)
+        bucket++;
+    t->buckets[bucket]++;
+}
+
+const ProfTimer* profTimer(ProfSlot slot) {
+    return &timers[slot];
+}
+
+const ProfAllocs* profAllocs(void) {
+    return &allocs;
+}
+
+//starts a new measurement window, e.g. after setup
+void profReset(void) {
+    memset(timers, 0, sizeof(timers));
+    memset(&allocs, 0, sizeof(allocs));
+}
+
+void* profMalloc(size_t size) {
+    allocs.mallocs++;
+    allocs.bytesRequested += (long long)size;
+    return malloc(size);
+}
+
+void* profCalloc(size_t count, size_t size) {
+    allocs.callocs++;
+    allocs.bytesRequested += (long long)(count * size);
+    return calloc(count, size);
+}
+
+void* profRealloc(void* ptr, size_t size) {
+    allocs.reallocs++;
+    allocs.bytesRequested += (long long)size;
+    return realloc(ptr, size);
+}
+
+void profFree(void* ptr) {
+    if (ptr != NULL)
+        allocs.frees++;
+    free(ptr);
+}
+
+/*
+ * Writes all timers and counters as one JSON object. Histograms list the
+ * count per power-of-two bucket up to the last non-empty one.
+ */
+void profDump(FILE* out) {
+#ifdef GAME_PROFILE
+    fprintf(out, "{\"enabled\": true, \"timers\": {");
+    int first = 1;
+    for (int s = 0; s < PROF_SLOT_COUNT; s++) {
+        const ProfTimer* t = &timers[s];
+        if (t->count == 0)
+            continue;
+
+        fprintf(out, "%s\n  \"%s\": {\"count\": %lld, \"total_ns\": %lld, \"mean_ns\": %lld, "
+            "\"min_ns\": %lld, \"max_ns\": %lld, \"log2_ns_buckets\": [",
+            first ? "" : ",", slotNames[s], t->count, t->totalNs, t->totalNs / t->count,
+            t->minNs, t->maxNs);
+        first = 0;
+
+        int last = PROF_BUCKETS - 1;
+        while (last > 0 && t->buckets[last] == 0)
+            last--;
+        for (int b = 0; b <= last; b++)
+            fprintf(out, "%s%lld", b ? ", " : "", t->buckets[b]);
+        fprintf(out, "]}");
+    }
+    fprintf(out, "\n}, \"allocs\": {\"malloc\": %lld, \"calloc\": %lld, \"realloc\": %lld, "
+        "\"free\": %lld, \"bytes_requested\": %lld}}\n",
+        allocs.mallocs, allocs.callocs, allocs.reallocs, allocs.frees, allocs.bytesRequested);
+#else
+    fprintf(out, "{\"enabled\": false}\n");
+#endif
+}
+
+// Dumps to a file ("-" is stdout), returns 0 if it cannot be written
+int profDumpToFile(const char* path) {
+    if (strcmp(path, "-") == 0) {
+        profDump(stdout);
+        return 1;
+    }
+
+    FILE* out = fopen(path, "w");
+    if (out == NULL)
+        return 0;
+    profDump(out);
+    return fclose(out) == 0;
+}
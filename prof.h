@@ -0,0 +1,81 @@
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "utils.h"
+
+/*
+ * Optional instrumentation, compiled in with -DGAME_PROFILE: nanosecond
+ * timers around every game action and the main subsystems, each feeding a
+ * log2 histogram, plus malloc/free counters. Without the flag the macros
+ * expand to nothing and profDump only reports that profiling is off.
+ * Statistics are per thread; the interactive game runs on one.
+ */
+typedef enum {
+    PROF_INPUT,
+    PROF_ACTION_MOVE,
+    PROF_ACTION_FIGHT,
+    PROF_ACTION_PICKUP,
+    PROF_ACTION_BAG,
+    PROF_ACTION_DEFEATED,
+    PROF_ADD_ROOM,
+    PROF_INIT_PLAYER,
+    PROF_DISPLAY_MAP,
+    PROF_PRINT_LEGEND,
+    PROF_FRAME_FLUSH,
+    PROF_WIN_CHECK,
+    PROF_BST_ADD,
+    PROF_BST_LOOKUP,
+    PROF_CHECKPOINT_RESTORE,
+    PROF_TEARDOWN,
+    PROF_SLOT_COUNT
+} ProfSlot;
+
+#define PROF_BUCKETS 48     // bucket i holds times in [2^i, 2^(i+1)) ns
+
+typedef struct {
+    long long count;
+    long long totalNs;
+    long long minNs;
+    long long maxNs;
+    long long buckets[PROF_BUCKETS];
+} ProfTimer;
+
+typedef struct {
+    long long mallocs;
+    long long callocs;
+    long long reallocs;
+    long long frees;
+    long long bytesRequested;
+} ProfAllocs;
+
+void profRecord(ProfSlot slot, long long ns);
+const ProfTimer* profTimer(ProfSlot slot);
+const ProfAllocs* profAllocs(void);
+void profReset(void);
+void profDump(FILE* out);
+int profDumpToFile(const char* path);
+
+void* profMalloc(size_t size);
+void* profCalloc(size_t count, size_t size);
+void* profRealloc(void* ptr, size_t size);
+void profFree(void* ptr);
+
+#ifdef GAME_PROFILE
+#define PROF_START(name) long long profStart_##name = nowNanos()
+#define PROF_STOP(name, slot) profRecord((slot), nowNanos() - profStart_##name)
+
+//every module includes this after <stdlib.h>, so its allocations are counted
+#ifndef PROF_IMPLEMENTATION
+#define malloc(size) profMalloc(size)
+#define calloc(count, size) profCalloc(count, size)
+#define realloc(ptr, size) profRealloc(ptr, size)
+#define free(ptr) profFree(ptr)
+#endif
+#else
+#define PROF_START(name)
+#define PROF_STOP(name, slot)
+#endif
+
+#endif
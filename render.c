@@ -0,0 +1,114 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "render.h"
+#include "utils.h"
+#include "prof.h"
+
+#define FB_MIN_CAPACITY 4096
+
+//makes room for extra more bytes, growing geometrically
+static void fbReserve(FrameBuffer* fb, size_t extra) {
+    if (fb->len + extra <= fb->capacity)
+        return;
+
+    size_t newCapacity = fb->capacity ? fb->capacity : FB_MIN_CAPACITY;
+    while (newCapacity < fb->len + extra)
+        newCapacity *= 2;
+
+    char* newData = (char*)realloc(fb->data, newCapacity);
+    if (newData == NULL)
+        exit(1);
+
+    fb->data = newData;
+    fb->capacity = newCapacity;
+}
+
+//starts a new frame, the memory of the previous one is reused
+void fbBegin(FrameBuffer* fb) {
+    fb->len = 0;
+    fb->frameStartNs = nowNanos();
+}
+
+void fbAppend(FrameBuffer* fb, const char* text, size_t len) {
+    //an empty, never used buffer has no data pointer to copy from
+    if (len == 0)
+        return;
+    fbReserve(fb, len);
+    memcpy(fb->data + fb->len, text, len);
+    fb->len += len;
+}
+
+void fbAppendChar(FrameBuffer* fb, char c) {
+    fbReserve(fb, 1);
+    fb->data[fb->len++] = c;
+}
+
+//same output as printf("%*d", width, value) without the format parsing
+void fbAppendInt(FrameBuffer* fb, int value, int width) {
+    char digits[16];
+    int count = 0;
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+
+    do {
+        digits[count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0)
+        digits[count++] = '-';
+
+    fbReserve(fb, (size_t)(count > width ? count : width));
+    for (int pad = width - count; pad > 0; pad--)
+        fb->data[fb->len++] = ' ';
+    while (count > 0)
+        fb->data[fb->len++] = digits[--count];
+}
+
+void fbPrintf(FrameBuffer* fb, const char* format, ...) {
+    va_list args;
+
+    fbReserve(fb, 256);
+    va_start(args, format);
+    int needed = vsnprintf(fb->data + fb->len, fb->capacity - fb->len, format, args);
+    va_end(args);
+    if (needed < 0)
+        return;
+
+    //the text did not fit, grow and format again
+    if ((size_t)needed >= fb->capacity - fb->len) {
+        fbReserve(fb, (size_t)needed + 1);
+        va_start(args, format);
+        vsnprintf(fb->data + fb->len, fb->capacity - fb->len, format, args);
+        va_end(args);
+    }
+    fb->len += (size_t)needed;
+}
+
+//writes the whole frame in one call and records what it cost
+void fbFlush(FrameBuffer* fb, FILE* out) {
+    if (fb->len > 0)
+        fwrite(fb->data, 1, fb->len, out);
+    fflush(out);
+
+    fb->lastFrameBytes = fb->len;
+    fb->lastFrameNs = nowNanos() - fb->frameStartNs;
+    fb->totalBytes += fb->len;
+    fb->totalNs += fb->lastFrameNs;
+    fb->frames++;
+    fb->len = 0;
+}
+
+void fbReport(const FrameBuffer* fb, FILE* out) {
+    fprintf(out, "render: %ld frames, %zu bytes, %.1f us/frame, %.1f bytes/frame\n",
+        fb->frames, fb->totalBytes,
+        fb->frames ? fb->totalNs / 1000.0 / fb->frames : 0.0,
+        fb->frames ? (double)fb->totalBytes / fb->frames : 0.0);
+}
+
+void fbFree(FrameBuffer* fb) {
+    free(fb->data);
+    fb->data = NULL;
+    fb->len = 0;
+    fb->capacity = 0;
+}
@@ -0,0 +1,35 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Reusable output buffer, a whole frame is formatted into it and then
+ * written out at once. It also keeps per-frame cost counters.
+ */
+typedef struct {
+    char* data;
+    size_t len;
+    size_t capacity;
+    long long frameStartNs;
+    long frames;
+    size_t totalBytes;
+    long long totalNs;
+    size_t lastFrameBytes;
+    long long lastFrameNs;
+} FrameBuffer;
+
+//appends a string literal without measuring it at run time
+#define fbAppendLiteral(fb, text) fbAppend((fb), (text), sizeof(text) - 1)
+
+void fbBegin(FrameBuffer* fb);
+void fbAppend(FrameBuffer* fb, const char* text, size_t len);
+void fbAppendChar(FrameBuffer* fb, char c);
+void fbAppendInt(FrameBuffer* fb, int value, int width);
+void fbPrintf(FrameBuffer* fb, const char* format, ...);
+void fbFlush(FrameBuffer* fb, FILE* out);
+void fbReport(const FrameBuffer* fb, FILE* out);
+void fbFree(FrameBuffer* fb);
+
+#endif
@@ -0,0 +1,87 @@
+#include <stdlib.h>
+#include "roomindex.h"
+#include "prof.h"
+
+#define ROOM_INDEX_MIN_CAPACITY 16
+
+//mixes both coordinates into one well spread 32 bit hash
+static unsigned int hashCoords(int x, int y) {
+    unsigned int h = (unsigned int)x * 0x9E3779B1u;
+    h ^= (unsigned int)y * 0x85EBCA77u;
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    return h;
+}
+
+//places a room in the first free slot of its probe sequence (no resize)
+static void placeSlot(RoomSlot* slots, int capacity, int x, int y, struct Room* room) {
+    unsigned int mask = (unsigned int)capacity - 1;
+    unsigned int i = hashCoords(x, y) & mask;
+
+    while (slots[i].room != NULL)
+        i = (i + 1) & mask;
+
+    slots[i].x = x;
+    slots[i].y = y;
+    slots[i].room = room;
+}
+
+//moves every room into a table of the new capacity
+static void rehash(RoomIndex* index, int newCapacity) {
+    RoomSlot* newSlots = calloc((size_t)newCapacity, sizeof(RoomSlot));
+    if (newSlots == NULL)
+        exit(1);
+
+    for (int i = 0; i < index->capacity; i++) {
+        RoomSlot* s = &index->slots[i];
+        if (s->room != NULL)
+            placeSlot(newSlots, newCapacity, s->x, s->y, s->room);
+    }
+
+    free(index->slots);
+    index->slots = newSlots;
+    index->capacity = newCapacity;
+}
+
+//makes sure count rooms fit while keeping the load factor at most 1/2
+void roomIndexReserve(RoomIndex* index, int count) {
+    int capacity = index->capacity ? index->capacity : ROOM_INDEX_MIN_CAPACITY;
+    while (capacity / 2 < count)
+        capacity *= 2;
+
+    if (capacity != index->capacity)
+        rehash(index, capacity);
+}
+
+//adds a room, the caller is responsible for not inserting the same coords twice
+void roomIndexInsert(RoomIndex* index, int x, int y, struct Room* room) {
+    roomIndexReserve(index, index->count + 1);
+    placeSlot(index->slots, index->capacity, x, y, room);
+    index->count++;
+}
+
+//returns the room at (x, y) or NULL if there is none
+struct Room* roomIndexFind(const RoomIndex* index, int x, int y) {
+    if (index->count == 0)
+        return NULL;
+
+    unsigned int mask = (unsigned int)index->capacity - 1;
+    unsigned int i = hashCoords(x, y) & mask;
+
+    while (index->slots[i].room != NULL) {
+        if (index->slots[i].x == x && index->slots[i].y == y)
+            return index->slots[i].room;
+        i = (i + 1) & mask;
+    }
+
+    return NULL;
+}
+
+//releases the table, the rooms themselves are owned by the game state
+void roomIndexFree(RoomIndex* index) {
+    free(index->slots);
+    index->slots = NULL;
+    index->capacity = 0;
+    index->count = 0;
+}
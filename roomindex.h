@@ -0,0 +1,24 @@
+#ifndef ROOMINDEX_H
+#define ROOMINDEX_H
+
+struct Room;
+
+//one open-addressing slot, coordinates kept inline so probing never touches the room
+typedef struct {
+    int x, y;
+    struct Room* room;
+} RoomSlot;
+
+//hash index of rooms keyed on (x, y), capacity is always a power of two
+typedef struct {
+    RoomSlot* slots;
+    int capacity;
+    int count;
+} RoomIndex;
+
+void roomIndexInsert(RoomIndex* index, int x, int y, struct Room* room);
+struct Room* roomIndexFind(const RoomIndex* index, int x, int y);
+void roomIndexReserve(RoomIndex* index, int count);
+void roomIndexFree(RoomIndex* index);
+
+#endif
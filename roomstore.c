@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <string.h>
+#include "roomstore.h"
+#include "prof.h"
+
+static void* growArray(void* array, size_t bytes) {
+    void* newArray = realloc(array, bytes);
+    if (newArray == NULL)
+        exit(1);
+    return newArray;
+}
+
+//grows every bitset to hold count rooms, new bits start cleared
+void roomStoreReserve(RoomStore* store, int count) {
+    if (count <= store->capacity)
+        return;
+
+    int newCapacity = store->capacity ? store->capacity : ROOM_STORE_WORD_BITS;
+    while (newCapacity < count)
+        newCapacity *= 2;
+
+    size_t oldWords = (size_t)store->capacity / ROOM_STORE_WORD_BITS;
+    size_t newWords = (size_t)newCapacity / ROOM_STORE_WORD_BITS;
+    size_t wordBytes = sizeof(unsigned long long);
+    store->visited = (unsigned long long*)growArray(store->visited, newWords * wordBytes);
+    store->hasMonster = (unsigned long long*)growArray(store->hasMonster, newWords * wordBytes);
+    store->hasItem = (unsigned long long*)growArray(store->hasItem, newWords * wordBytes);
+    memset(store->visited + oldWords, 0, (newWords - oldWords) * wordBytes);
+    memset(store->hasMonster + oldWords, 0, (newWords - oldWords) * wordBytes);
+    memset(store->hasItem + oldWords, 0, (newWords - oldWords) * wordBytes);
+    store->capacity = newCapacity;
+}
+
+//appends a room with all flags clear, returns its id
+int roomStoreAdd(RoomStore* store) {
+    if (store->count == store->capacity)
+        roomStoreReserve(store, store->count + 1);
+    return store->count++;
+}
+
+/*
+ * 1 if every room is visited and no monster is left. One pass over two
+ * bitsets, ORed together word by word with no branch in the loop.
+ */
+int roomStoreAllCleared(const RoomStore* store) {
+    int fullWords = store->count / ROOM_STORE_WORD_BITS;
+    unsigned long long pending = 0;
+
+    for (int w = 0; w < fullWords; w++)
+        pending |= ~store->visited[w] | store->hasMonster[w];
+
+    int tail = store->count % ROOM_STORE_WORD_BITS;
+    if (tail > 0) {
+        unsigned long long mask = (1ull << tail) - 1;
+        pending |= (~store->visited[fullWords] | store->hasMonster[fullWords]) & mask;
+    }
+    return pending == 0;
+}
+
+//first room id >= from with a monster in it, -1 if there is none
+int roomStoreNextMonster(const RoomStore* store, int from) {
+    if (from < 0)
+        from = 0;
+
+    int w = from / ROOM_STORE_WORD_BITS;
+    int words = (store->count + ROOM_STORE_WORD_BITS - 1) / ROOM_STORE_WORD_BITS;
+    unsigned long long bits = w < words ? store->hasMonster[w] >> (from % ROOM_STORE_WORD_BITS) : 0;
+    int id = from;
+
+    //empty words are skipped whole
+    while (bits == 0) {
+        if (++w >= words)
+            return -1;
+        bits = store->hasMonster[w];
+        id = w * ROOM_STORE_WORD_BITS;
+    }
+    while ((bits & 1) == 0) {
+        bits >>= 1;
+        id++;
+    }
+    return id < store->count ? id : -1;
+}
+
+//bytes held by the store, for the memory report
+size_t roomStoreBytes(const RoomStore* store) {
+    size_t words = (size_t)store->capacity / ROOM_STORE_WORD_BITS;
+    return 3 * words * sizeof(unsigned long long);
+}
+
+void roomStoreFree(RoomStore* store) {
+    free(store->visited);
+    free(store->hasMonster);
+    free(store->hasItem);
+    memset(store, 0, sizeof(*store));
+}
@@ -0,0 +1,48 @@
+#ifndef ROOMSTORE_H
+#define ROOMSTORE_H
+
+#include <stddef.h>
+
+#define ROOM_STORE_WORD_BITS 64
+
+/*
+ * One bit per room, indexed by room id, for visited, monster present and
+ * item present. Passes that only ask "which rooms still matter" (the bot's
+ * search, monster collection, the debug win check) sweep these words
+ * instead of touching one Room per id, at 3 bits of extra memory per room.
+ * The Room objects stay the source of truth, the game keeps the bits in
+ * sync whenever it changes one of them.
+ */
+typedef struct {
+    unsigned long long* visited;
+    unsigned long long* hasMonster;
+    unsigned long long* hasItem;
+    int count;
+    int capacity;           // rooms, always a multiple of ROOM_STORE_WORD_BITS
+} RoomStore;
+
+static inline int roomStoreTest(const unsigned long long* bits, int id) {
+    return (int)((bits[id / ROOM_STORE_WORD_BITS] >> (id % ROOM_STORE_WORD_BITS)) & 1);
+}
+
+static inline void roomStoreSet(unsigned long long* bits, int id, int on) {
+    unsigned long long mask = 1ull << (id % ROOM_STORE_WORD_BITS);
+    if (on)
+        bits[id / ROOM_STORE_WORD_BITS] |= mask;
+    else
+        bits[id / ROOM_STORE_WORD_BITS] &= ~mask;
+}
+
+//rooms the bot still has to reach: not visited yet, or a monster still in them
+static inline int roomStorePending(const RoomStore* store, int id) {
+    return !roomStoreTest(store->visited, id) || roomStoreTest(store->hasMonster, id);
+}
+
+void roomStoreReserve(RoomStore* store, int count);
+int roomStoreAdd(RoomStore* store);
+int roomStoreAllCleared(const RoomStore* store);
+int roomStoreNextMonster(const RoomStore* store, int from);
+size_t roomStoreBytes(const RoomStore* store);
+void roomStoreFree(RoomStore* store);
+
+#endif
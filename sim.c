@@ -0,0 +1,446 @@
+#define _CRT_SECURE_NO_WARNINGS
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include "sim.h"
+#include "prof.h"
+
+#define SIM_MAX_THREADS 256
+
+static const char* const monsterNames[] = {
+    "Goblin", "Spider", "Wraith", "Golem", "Cobra", "Imp", "Ogre", "Ghoul"
+};
+static const char* const itemNames[] = {
+    "Sword", "Shield", "Helm", "Axe", "Mail", "Dagger", "Bow", "Boots"
+};
+
+//per-direction steps, must agree with computeNewCoords
+static const int stepX[4] = { 0, 0, -1, 1 };
+static const int stepY[4] = { -1, 1, 0, 0 };
+
+/*
+ * Minimal thread layer: one mutex per worker plus start/join.
+ */
+#ifdef _WIN32
+typedef CRITICAL_SECTION SimLock;
+#define simLockInit(l) InitializeCriticalSection(l)
+#define simLockDestroy(l) DeleteCriticalSection(l)
+#define simLock(l) EnterCriticalSection(l)
+#define simUnlock(l) LeaveCriticalSection(l)
+#else
+typedef pthread_mutex_t SimLock;
+#define simLockInit(l) pthread_mutex_init(l, NULL)
+#define simLockDestroy(l) pthread_mutex_destroy(l)
+#define simLock(l) pthread_mutex_lock(l)
+#define simUnlock(l) pthread_mutex_unlock(l)
+#endif
+
+/*
+ * Each worker owns a range [next, end) of game indexes. It takes games from
+ * the front of its own range and, once that is empty, steals the back half
+ * of the largest range left. Results are summed locally and merged at the end.
+ */
+typedef struct SimWorker {
+    SimLock lock;
+    int next;
+    int end;
+    struct SimWorker* all;
+    int workerCount;
+    const SimConfig* config;
+    SimResult result;
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+} SimWorker;
+
+//splitmix64, small and good enough to give every game its own stream
+static unsigned long long nextRandom(unsigned long long* state) {
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+//uniform-ish integer in [lo, hi]
+static int randomRange(unsigned long long* rng, int lo, int hi) {
+    return lo + (int)(nextRandom(rng) % (unsigned long long)(hi - lo + 1));
+}
+
+// Fills the simulation settings with the defaults used by --sim
+void simDefaultConfig(SimConfig* config) {
+    memset(config, 0, sizeof(*config));
+    config->games = 1000;
+    config->rooms = 24;
+    config->monsterPercent = 40;
+    config->itemPercent = 30;
+    config->maxHp = 100;
+    config->baseAttack = 10;
+    config->maxTurns = 10000;
+    config->useArena = 1;
+    config->seed = 1;
+}
+
+/*
+ * Builds a random connected dungeon through gameStep: every room is
+ * attached to a random existing room, so the map is always reachable.
+ * Returns 0 if the rooms could not be placed.
+ */
+int simGenerateWorld(GameState* g, const SimConfig* config, unsigned long long* rng) {
+    Command cmd = { .type = CMD_ADD_ROOM };
+    StepOutput out;
+
+    if (gameStep(g, &cmd, &out) != STEP_OK)
+        return 0;
+
+    int attempts = 0;
+    while (g->roomCount < config->rooms) {
+        //a crowded spot only costs another roll
+        if (++attempts > config->rooms * 64)
+            return 0;
+
+        cmd.type = CMD_ADD_ROOM;
+        cmd.roomId = randomRange(rng, 0, g->roomCount - 1);
+        cmd.direction = (Direction)randomRange(rng, UP, RIGHT);
+        if (gameStep(g, &cmd, &out) != STEP_OK)
+            continue;
+        int roomId = out.room->id;
+
+        if (randomRange(rng, 1, 100) <= config->monsterPercent) {
+            Command monster = { .type = CMD_ADD_MONSTER, .roomId = roomId };
+            monster.name = monsterNames[randomRange(rng, 0, 7)];
+            monster.kind = randomRange(rng, PHANTOM, COBRA);
+            monster.hp = randomRange(rng, 5, 40);
+            monster.attack = randomRange(rng, 1, 8);
+            gameStep(g, &monster, &out);
+        }
+
+        if (randomRange(rng, 1, 100) <= config->itemPercent) {
+            Command item = { .type = CMD_ADD_ITEM, .roomId = roomId };
+            item.name = itemNames[randomRange(rng, 0, 7)];
+            item.kind = randomRange(rng, ARMOR, SWORD);
+            item.value = randomRange(rng, 1, 20);
+            gameStep(g, &item, &out);
+        }
+    }
+    return 1;
+}
+
+/*
+ * Bot policy: fight whatever is in the room, pick up what is new, then walk
+ * towards the nearest room that is unvisited or still has a monster.
+ * Returns the direction of the first step, or -1 when nothing is left.
+ */
+static int chooseDirection(GameState* g, int* prevRoom, int* queue) {
+    const RoomStore* store = &g->roomStore;
+    Room* const* rooms = g->roomTable;
+    int start = g->player->currentRoom->id;
+    int head = 0;
+    int tail = 0;
+
+    for (int i = 0; i < g->roomCount; i++)
+        prevRoom[i] = -1;
+    prevRoom[start] = start;
+    queue[tail++] = start;
+
+    //the search works on room ids, the pending test reads only the flag bitsets
+    while (head < tail) {
+        int id = queue[head++];
+
+        if (id != start && roomStorePending(store, id)) {
+            //walk the path back to the room right after the start
+            while (prevRoom[id] != start)
+                id = prevRoom[id];
+            for (int d = UP; d <= RIGHT; d++) {
+                if (rooms[id]->x == rooms[start]->x + stepX[d]
+                    && rooms[id]->y == rooms[start]->y + stepY[d])
+                    return d;
+            }
+        }
+
+        for (int d = UP; d <= RIGHT; d++) {
+            Room* next = findRoomByCoords(g, rooms[id]->x + stepX[d], rooms[id]->y + stepY[d]);
+            if (next != NULL && prevRoom[next->id] < 0) {
+                prevRoom[next->id] = id;
+                queue[tail++] = next->id;
+            }
+        }
+    }
+    return -1;
+}
+
+//records one finished game in the worker totals
+static void recordGame(SimResult* result, StepStatus status, int turns, int hpLeft) {
+    if (result->games == 0 || turns < result->minTurns)
+        result->minTurns = turns;
+    if (turns > result->maxTurns)
+        result->maxTurns = turns;
+    result->games++;
+    result->turns += turns;
+
+    if (status == STEP_WON) {
+        if (result->wins == 0 || hpLeft < result->minWinHp)
+            result->minWinHp = hpLeft;
+        if (hpLeft > result->maxWinHp)
+            result->maxWinHp = hpLeft;
+        result->wins++;
+        result->winHpLeft += hpLeft;
+    }
+    else if (status == STEP_PLAYER_DIED) {
+        result->deaths++;
+    }
+    else {
+        result->stalls++;
+    }
+}
+
+// Generates and plays game number gameIndex, adding its outcome to result
+void simRunGame(const SimConfig* config, int gameIndex, SimResult* result) {
+    GameState game = {0};
+    game.configMaxHp = config->maxHp;
+    game.configBaseAttack = config->baseAttack;
+    game.useBTree = config->useBTree;
+    if (config->useArena)
+        game.arena = createArena(0);
+
+    unsigned long long rng = config->seed ^ ((unsigned long long)gameIndex * 0xD1B54A32D192ED03ull);
+    StepStatus status = STEP_BAD_COMMAND;
+    int turns = 0;
+
+    Command cmd = { .type = CMD_INIT_PLAYER };
+    StepOutput out;
+    if (simGenerateWorld(&game, config, &rng) && gameStep(&game, &cmd, &out) == STEP_OK) {
+        int* prevRoom = (int*)malloc(2 * (size_t)game.roomCount * sizeof(int));
+        if (prevRoom == NULL)
+            exit(1);
+        int* queue = prevRoom + game.roomCount;
+
+        //anything but STEP_OK ends the game, a rejected command counts as a stall
+        status = STEP_OK;
+        while (status == STEP_OK && turns < config->maxTurns) {
+            Room* room = game.player->currentRoom;
+            cmd.type = CMD_MOVE;
+
+            if (room->monster != NULL) {
+                cmd.type = CMD_FIGHT;
+            }
+            else if (room->item != NULL && bstLookup(game.player->bag, room->item) == NULL) {
+                cmd.type = CMD_PICKUP;
+            }
+            else {
+                int direction = chooseDirection(&game, prevRoom, queue);
+                //only the room we stand in is left, leaving it marks it visited
+                if (direction < 0) {
+                    for (direction = UP; direction < RIGHT; direction++) {
+                        if (findRoomByCoords(&game, room->x + stepX[direction],
+                            room->y + stepY[direction]) != NULL)
+                            break;
+                    }
+                }
+                cmd.direction = (Direction)direction;
+            }
+
+            status = gameStep(&game, &cmd, &out);
+            turns++;
+            if (cmd.type == CMD_FIGHT)
+                result->monstersKilled += status == STEP_OK || status == STEP_WON;
+            else if (cmd.type == CMD_PICKUP)
+                result->itemsPicked += status == STEP_OK;
+        }
+
+        free(prevRoom);
+    }
+
+    recordGame(result, status, turns, game.player != NULL ? game.player->hp : 0);
+    freeGame(&game);
+}
+
+//takes the next game of this worker, stealing half of another range when empty
+static int takeGame(SimWorker* self) {
+    simLock(&self->lock);
+    if (self->next < self->end) {
+        int game = self->next++;
+        simUnlock(&self->lock);
+        return game;
+    }
+    simUnlock(&self->lock);
+
+    for (;;) {
+        SimWorker* victim = NULL;
+        int most = 0;
+        for (int i = 0; i < self->workerCount; i++) {
+            SimWorker* w = &self->all[i];
+            if (w == self)
+                continue;
+            simLock(&w->lock);
+            int left = w->end - w->next;
+            simUnlock(&w->lock);
+            if (left > most) {
+                most = left;
+                victim = w;
+            }
+        }
+        if (victim == NULL)
+            return -1;
+
+        //the victim may have moved on since the scan, recheck under its lock
+        simLock(&victim->lock);
+        int left = victim->end - victim->next;
+        if (left <= 0) {
+            simUnlock(&victim->lock);
+            continue;
+        }
+        int stolenEnd = victim->end;
+        int stolenStart = stolenEnd - (left + 1) / 2;
+        victim->end = stolenStart;
+        simUnlock(&victim->lock);
+
+        simLock(&self->lock);
+        self->next = stolenStart + 1;
+        self->end = stolenEnd;
+        simUnlock(&self->lock);
+        return stolenStart;
+    }
+}
+
+static void workerLoop(SimWorker* self) {
+    int game;
+    while ((game = takeGame(self)) >= 0)
+        simRunGame(self->config, game, &self->result);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI workerMain(LPVOID arg) {
+    workerLoop((SimWorker*)arg);
+    return 0;
+}
+#else
+static void* workerMain(void* arg) {
+    workerLoop((SimWorker*)arg);
+    return NULL;
+}
+#endif
+
+static int onlineCores(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+#endif
+}
+
+//folds one worker's totals into the overall result
+static void mergeResult(SimResult* total, const SimResult* part) {
+    if (part->games == 0)
+        return;
+
+    if (total->games == 0 || part->minTurns < total->minTurns)
+        total->minTurns = part->minTurns;
+    if (part->maxTurns > total->maxTurns)
+        total->maxTurns = part->maxTurns;
+    if (part->wins > 0) {
+        if (total->wins == 0 || part->minWinHp < total->minWinHp)
+            total->minWinHp = part->minWinHp;
+        if (part->maxWinHp > total->maxWinHp)
+            total->maxWinHp = part->maxWinHp;
+    }
+
+    total->games += part->games;
+    total->wins += part->wins;
+    total->deaths += part->deaths;
+    total->stalls += part->stalls;
+    total->turns += part->turns;
+    total->winHpLeft += part->winHpLeft;
+    total->monstersKilled += part->monstersKilled;
+    total->itemsPicked += part->itemsPicked;
+}
+
+/*
+ * Plays config->games games on config->threads workers (the calling thread
+ * is worker 0) and fills result with the merged totals.
+ */
+void runSimulations(const SimConfig* config, SimResult* result) {
+    memset(result, 0, sizeof(*result));
+
+    int threads = config->threads > 0 ? config->threads : onlineCores();
+    if (threads > SIM_MAX_THREADS)
+        threads = SIM_MAX_THREADS;
+    if (threads > config->games)
+        threads = config->games > 0 ? config->games : 1;
+
+    SimWorker* workers = (SimWorker*)calloc((size_t)threads, sizeof(SimWorker));
+    if (workers == NULL)
+        exit(1);
+
+    //even initial split, stealing evens out the rest
+    for (int i = 0; i < threads; i++) {
+        SimWorker* w = &workers[i];
+        simLockInit(&w->lock);
+        w->next = (int)((long long)config->games * i / threads);
+        w->end = (int)((long long)config->games * (i + 1) / threads);
+        w->all = workers;
+        w->workerCount = threads;
+        w->config = config;
+    }
+
+    long long start = nowNanos();
+    for (int i = 1; i < threads; i++) {
+#ifdef _WIN32
+        workers[i].thread = CreateThread(NULL, 0, workerMain, &workers[i], 0, NULL);
+        if (workers[i].thread == NULL)
+            exit(1);
+#else
+        if (pthread_create(&workers[i].thread, NULL, workerMain, &workers[i]) != 0)
+            exit(1);
+#endif
+    }
+    workerLoop(&workers[0]);
+    for (int i = 1; i < threads; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(workers[i].thread, INFINITE);
+        CloseHandle(workers[i].thread);
+#else
+        pthread_join(workers[i].thread, NULL);
+#endif
+    }
+    result->elapsedNs = nowNanos() - start;
+    result->threads = threads;
+
+    for (int i = 0; i < threads; i++) {
+        mergeResult(result, &workers[i].result);
+        simLockDestroy(&workers[i].lock);
+    }
+    free(workers);
+}
+
+// Prints the aggregate statistics of a simulation run
+void simReport(const SimResult* r, FILE* out) {
+    double games = r->games > 0 ? (double)r->games : 1.0;
+    double wins = r->wins > 0 ? (double)r->wins : 1.0;
+    double seconds = r->elapsedNs / 1e9;
+
+    fprintf(out, "=== SIMULATION ===\n");
+    fprintf(out, "games: %d on %d threads in %.3f s (%.0f games/s)\n",
+        r->games, r->threads, seconds, seconds > 0 ? r->games / seconds : 0.0);
+    fprintf(out, "won: %d (%.1f%%)  died: %d (%.1f%%)  stalled: %d\n",
+        r->wins, 100.0 * r->wins / games, r->deaths, 100.0 * r->deaths / games, r->stalls);
+    fprintf(out, "turns: mean %.1f  min %d  max %d\n",
+        r->turns / games, r->minTurns, r->maxTurns);
+    fprintf(out, "hp left on win: mean %.1f  min %d  max %d\n",
+        r->winHpLeft / wins, r->minWinHp, r->maxWinHp);
+    fprintf(out, "monsters killed: %.2f per game  items picked: %.2f per game\n",
+        r->monstersKilled / games, r->itemsPicked / games);
+}
@@ -0,0 +1,52 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdio.h>
+#include "game.h"
+
+/*
+ * Headless balancing runs: generates random dungeons and lets a bot play
+ * them through gameStep on a pool of worker threads. Every game owns its
+ * own GameState (and arena), so workers share nothing but the queue of
+ * game indexes. Game i always gets the same world for the same seed, so the
+ * totals do not depend on the number of threads.
+ * POSIX builds need -pthread.
+ */
+typedef struct {
+    int games;
+    int threads;            // 0 picks the number of online cores
+    int rooms;              // rooms per generated dungeon
+    int monsterPercent;     // chance of a monster in each room but the first
+    int itemPercent;
+    int maxHp;              // player config, same as the command line
+    int baseAttack;
+    int maxTurns;           // a game still running after this many steps stalls
+    int useArena;
+    int useBTree;           // bot inventories in the B-tree backend
+    unsigned long long seed;
+} SimConfig;
+
+typedef struct {
+    int games;
+    int wins;
+    int deaths;
+    int stalls;
+    long long turns;        // summed over all games
+    int minTurns;
+    int maxTurns;
+    long long winHpLeft;    // player hp at the end, summed over wins
+    int minWinHp;
+    int maxWinHp;
+    long long monstersKilled;
+    long long itemsPicked;
+    int threads;
+    long long elapsedNs;
+} SimResult;
+
+void simDefaultConfig(SimConfig* config);
+int simGenerateWorld(GameState* g, const SimConfig* config, unsigned long long* rng);
+void simRunGame(const SimConfig* config, int gameIndex, SimResult* result);
+void runSimulations(const SimConfig* config, SimResult* result);
+void simReport(const SimResult* result, FILE* out);
+
+#endif
@@ -0,0 +1,493 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snapshot.h"
+#include "world.h"
+#include "prof.h"
+
+#define SNAPSHOT_WRITE_BUFFER (1 << 20)
+#define SNAPSHOT_TMP_SUFFIX ".tmp"
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t roomCount;
+    uint32_t monsterCount;
+    uint32_t itemCount;
+    uint32_t bagCount;
+    uint32_t defeatedCount;
+    uint32_t stringBytes;
+    int32_t hasPlayer;
+    int32_t hp, maxHp, baseAttack;
+    int32_t currentRoom;
+    int32_t bagBalanced, defeatedBalanced;
+} SnapshotHeader;
+
+typedef struct {
+    int32_t x, y;
+    int32_t visited;
+    int32_t monster;
+    int32_t item;
+} SnapRoom;
+
+typedef struct {
+    uint32_t name;
+    int32_t type;
+    int32_t hp, maxHp;
+    int32_t attack;
+} SnapMonster;
+
+typedef struct {
+    uint32_t name;
+    int32_t type;
+    int32_t value;
+} SnapItem;
+
+//B-trees have no binary layout, their elements are saved in key order
+static BSTOrder saveOrder(BST* tree) {
+    return tree->btree != NULL ? BST_INORDER : BST_PREORDER;
+}
+
+//state shared by the tree walks of saveSnapshot
+typedef struct {
+    FILE* out;
+    uint32_t count;
+    uint32_t* nameAt;
+    int32_t* nextIndex;
+} TreeWalk;
+
+static void countVisit(void* data, void* ctx) {
+    (void)data;
+    ((TreeWalk*)ctx)->count++;
+}
+
+static void nameBytesVisit(void* data, void* ctx) {
+    //Item and Monster both start with their name
+    ((TreeWalk*)ctx)->count += (uint32_t)strlen(*(char**)data) + 1;
+}
+
+//counts the elements of a tree without recursion
+static uint32_t countNodes(BST* tree) {
+    TreeWalk walk = { NULL, 0, NULL, NULL };
+    bstForEach(tree, saveOrder(tree), countVisit, &walk);
+    return walk.count;
+}
+
+static uint32_t treeNameBytes(BST* tree) {
+    TreeWalk walk = { NULL, 0, NULL, NULL };
+    bstForEach(tree, saveOrder(tree), nameBytesVisit, &walk);
+    return walk.count;
+}
+
+static void indexVisit(void* data, void* ctx) {
+    TreeWalk* walk = (TreeWalk*)ctx;
+    int32_t index = (*walk->nextIndex)++;
+    (void)data;
+    fwrite(&index, sizeof(index), 1, walk->out);
+}
+
+//writes one tree section: the running index of every node, in save order
+static void writeTreeIndexes(FILE* out, BST* tree, int32_t* nextIndex) {
+    TreeWalk walk = { out, 0, NULL, nextIndex };
+    bstForEach(tree, saveOrder(tree), indexVisit, &walk);
+}
+
+//B-tree backed trees write a zero byte per element, restore re-inserts them
+static void writeTreeShape(FILE* out, BST* tree) {
+    BSTIterator it;
+    BSTNode* node;
+
+    if (tree->btree != NULL) {
+        for (uint32_t i = countNodes(tree); i > 0; i--)
+            fputc(0, out);
+        return;
+    }
+
+    bstIterBegin(&it, tree->root, BST_PREORDER);
+    while ((node = bstIterNextNode(&it)) != NULL) {
+        unsigned char shape = (node->left ? BST_HAS_LEFT : 0) | (node->right ? BST_HAS_RIGHT : 0);
+        fputc(shape, out);
+    }
+    bstIterEnd(&it);
+}
+
+static void writeMonster(FILE* out, Monster* m, uint32_t* nameAt) {
+    SnapMonster record = { *nameAt, (int32_t)m->type, m->hp, m->maxHp, m->attack };
+    fwrite(&record, sizeof(record), 1, out);
+    *nameAt += (uint32_t)strlen(m->name) + 1;
+}
+
+static void writeItem(FILE* out, Item* it, uint32_t* nameAt) {
+    SnapItem record = { *nameAt, (int32_t)it->type, it->value };
+    fwrite(&record, sizeof(record), 1, out);
+    *nameAt += (uint32_t)strlen(it->name) + 1;
+}
+
+static void writeName(FILE* out, const char* name) {
+    fwrite(name, 1, strlen(name) + 1, out);
+}
+
+static void writeMonsterVisit(void* data, void* ctx) {
+    TreeWalk* walk = (TreeWalk*)ctx;
+    writeMonster(walk->out, (Monster*)data, walk->nameAt);
+}
+
+static void writeItemVisit(void* data, void* ctx) {
+    TreeWalk* walk = (TreeWalk*)ctx;
+    writeItem(walk->out, (Item*)data, walk->nameAt);
+}
+
+static void writeNameVisit(void* data, void* ctx) {
+    writeName(((TreeWalk*)ctx)->out, *(char**)data);
+}
+
+//tree value of the *Balanced header fields
+static int32_t treeMode(BST* tree) {
+    return tree->btree != NULL ? SNAPSHOT_TREE_BTREE : tree->balanced;
+}
+
+/*
+ * Streams the whole game into path in one sequential pass per section.
+ * The file is written next to path and renamed over it at the end, so a
+ * crash never leaves a half written snapshot (and a game restored from
+ * the same path keeps its mapping valid).
+ * Returns 1 on success, 0 on I/O failure.
+ */
+int saveSnapshot(GameState* g, const char* path) {
+    size_t pathLen = strlen(path);
+    char* tmpPath = (char*)malloc(pathLen + sizeof(SNAPSHOT_TMP_SUFFIX));
+    if (tmpPath == NULL)
+        exit(1);
+    memcpy(tmpPath, path, pathLen);
+    memcpy(tmpPath + pathLen, SNAPSHOT_TMP_SUFFIX, sizeof(SNAPSHOT_TMP_SUFFIX));
+
+    FILE* out = fopen(tmpPath, "wb");
+    if (out == NULL) {
+        free(tmpPath);
+        return 0;
+    }
+    setvbuf(out, NULL, _IOFBF, SNAPSHOT_WRITE_BUFFER);
+
+    Player* player = g->player;
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, 4);
+    header.version = SNAPSHOT_VERSION;
+    header.roomCount = (uint32_t)g->roomCount;
+    header.currentRoom = -1;
+    if (player != NULL) {
+        header.hasPlayer = 1;
+        header.hp = player->hp;
+        header.maxHp = player->maxHp;
+        header.baseAttack = player->baseAttack;
+        header.currentRoom = player->currentRoom ? player->currentRoom->id : -1;
+        header.bagCount = countNodes(player->bag);
+        header.defeatedCount = countNodes(player->defeatedMonsters);
+        header.bagBalanced = treeMode(player->bag);
+        header.defeatedBalanced = treeMode(player->defeatedMonsters);
+    }
+
+    //first pass: sizes of every section
+    uint32_t roomMonsters = 0, roomItems = 0;
+    for (int i = 0; i < g->roomCount; i++) {
+        Room* room = g->roomTable[i];
+        if (room->monster) {
+            roomMonsters++;
+            header.stringBytes += (uint32_t)strlen(room->monster->name) + 1;
+        }
+        if (room->item) {
+            roomItems++;
+            header.stringBytes += (uint32_t)strlen(room->item->name) + 1;
+        }
+    }
+    if (player != NULL) {
+        header.stringBytes += treeNameBytes(player->defeatedMonsters);
+        header.stringBytes += treeNameBytes(player->bag);
+    }
+    header.monsterCount = roomMonsters + header.defeatedCount;
+    header.itemCount = roomItems + header.bagCount;
+    fwrite(&header, sizeof(header), 1, out);
+
+    //rooms: room monsters/items take the first indexes, trees follow
+    int32_t monsterIndex = 0, itemIndex = 0;
+    for (int i = 0; i < g->roomCount; i++) {
+        Room* room = g->roomTable[i];
+        SnapRoom record = { room->x, room->y, room->visited,
+            room->monster ? monsterIndex++ : -1,
+            room->item ? itemIndex++ : -1 };
+        fwrite(&record, sizeof(record), 1, out);
+    }
+
+    //monsters and items, names are laid out in the same order
+    uint32_t nameAt = 0;
+    TreeWalk walk = { out, 0, &nameAt, NULL };
+
+    for (int i = 0; i < g->roomCount; i++)
+        if (g->roomTable[i]->monster)
+            writeMonster(out, g->roomTable[i]->monster, &nameAt);
+    if (player != NULL)
+        bstForEach(player->defeatedMonsters, saveOrder(player->defeatedMonsters), writeMonsterVisit, &walk);
+
+    for (int i = 0; i < g->roomCount; i++)
+        if (g->roomTable[i]->item)
+            writeItem(out, g->roomTable[i]->item, &nameAt);
+    if (player != NULL) {
+        bstForEach(player->bag, saveOrder(player->bag), writeItemVisit, &walk);
+
+        writeTreeIndexes(out, player->bag, &itemIndex);
+        writeTreeIndexes(out, player->defeatedMonsters, &monsterIndex);
+        writeTreeShape(out, player->bag);
+        writeTreeShape(out, player->defeatedMonsters);
+    }
+
+    for (int i = 0; i < g->roomCount; i++)
+        if (g->roomTable[i]->monster)
+            writeName(out, g->roomTable[i]->monster->name);
+    if (player != NULL)
+        bstForEach(player->defeatedMonsters, saveOrder(player->defeatedMonsters), writeNameVisit, &walk);
+    for (int i = 0; i < g->roomCount; i++)
+        if (g->roomTable[i]->item)
+            writeName(out, g->roomTable[i]->item->name);
+    if (player != NULL)
+        bstForEach(player->bag, saveOrder(player->bag), writeNameVisit, &walk);
+
+    int ok = !ferror(out);
+    ok &= fclose(out) == 0;
+    if (ok) {
+        remove(path);
+        ok = rename(tmpPath, path) == 0;
+    }
+    else {
+        remove(tmpPath);
+    }
+
+    free(tmpPath);
+    return ok;
+}
+
+//marks index as used, fails if it is out of range or already taken
+static int claimIndex(unsigned char* used, int32_t index, uint32_t count) {
+    if (index < 0 || (uint32_t)index >= count || used[index])
+        return 0;
+    used[index] = 1;
+    return 1;
+}
+
+//checks that every monster and item belongs to exactly one place
+static int validateRefs(const SnapshotHeader* header, const SnapRoom* rooms,
+                        const int32_t* bag, const int32_t* defeated) {
+    unsigned char* monstersUsed = (unsigned char*)calloc((size_t)header->monsterCount + 1, 1);
+    unsigned char* itemsUsed = (unsigned char*)calloc((size_t)header->itemCount + 1, 1);
+    if (monstersUsed == NULL || itemsUsed == NULL)
+        exit(1);
+
+    int ok = 1;
+    for (uint32_t i = 0; i < header->roomCount && ok; i++) {
+        if (rooms[i].monster != -1)
+            ok &= claimIndex(monstersUsed, rooms[i].monster, header->monsterCount);
+        if (rooms[i].item != -1)
+            ok &= claimIndex(itemsUsed, rooms[i].item, header->itemCount);
+    }
+    for (uint32_t i = 0; i < header->bagCount && ok; i++)
+        ok &= claimIndex(itemsUsed, bag[i], header->itemCount);
+    for (uint32_t i = 0; i < header->defeatedCount && ok; i++)
+        ok &= claimIndex(monstersUsed, defeated[i], header->monsterCount);
+
+    free(monstersUsed);
+    free(itemsUsed);
+    return ok;
+}
+
+/*
+ * Node trees saved by shape come back node by node, B-trees were saved in
+ * key order and are bulk built. Only an AVL file restored into a B-tree
+ * has to insert one element at a time.
+ */
+static int restoreTree(BST* tree, void** data, const unsigned char* shape, int count, int32_t mode) {
+    if (mode == SNAPSHOT_TREE_BTREE)
+        return bstBuildSorted(tree, data, count);
+    if (tree->btree == NULL)
+        return bstRestorePreorder(tree, data, shape, count);
+
+    for (int i = 0; i < count; i++)
+        bstAdd(tree, data[i]);
+    return 1;
+}
+
+/*
+ * Restores a snapshot into an empty game. Like loadWorld the file is
+ * mapped, names are used in place and the game switches to arena mode.
+ * Returns 1 on success, 0 (with a message) if the file is invalid.
+ */
+int loadSnapshot(GameState* g, const char* path) {
+    if (g->roomCount != 0 || g->player != NULL || g->worldFile.data != NULL) {
+        fprintf(stderr, "Snapshot can only be restored into an empty game\n");
+        return 0;
+    }
+
+    MappedFile file;
+    if (!mapFile(path, &file)) {
+        fprintf(stderr, "Cannot read snapshot %s\n", path);
+        return 0;
+    }
+
+    SnapshotHeader header;
+    if (file.size < sizeof(header)) {
+        fprintf(stderr, "Snapshot %s is truncated\n", path);
+        unmapFile(&file);
+        return 0;
+    }
+    memcpy(&header, file.data, sizeof(header));
+
+    uint64_t roomsAt = sizeof(SnapshotHeader);
+    uint64_t monstersAt = roomsAt + (uint64_t)header.roomCount * sizeof(SnapRoom);
+    uint64_t itemsAt = monstersAt + (uint64_t)header.monsterCount * sizeof(SnapMonster);
+    uint64_t bagAt = itemsAt + (uint64_t)header.itemCount * sizeof(SnapItem);
+    uint64_t defeatedAt = bagAt + (uint64_t)header.bagCount * sizeof(int32_t);
+    uint64_t bagShapeAt = defeatedAt + (uint64_t)header.defeatedCount * sizeof(int32_t);
+    uint64_t defeatedShapeAt = bagShapeAt + header.bagCount;
+    uint64_t stringsAt = defeatedShapeAt + header.defeatedCount;
+    uint64_t expectedSize = stringsAt + header.stringBytes;
+
+    int valid = memcmp(header.magic, SNAPSHOT_MAGIC, 4) == 0
+        && header.version == SNAPSHOT_VERSION
+        && header.roomCount <= INT32_MAX
+        && header.bagCount <= INT32_MAX && header.defeatedCount <= INT32_MAX
+        && expectedSize == file.size
+        && (header.stringBytes == 0 || file.data[file.size - 1] == '\0')
+        && (header.hasPlayer
+            ? header.currentRoom >= 0 && (uint32_t)header.currentRoom < header.roomCount
+            : header.bagCount == 0 && header.defeatedCount == 0);
+    if (!valid) {
+        fprintf(stderr, "Snapshot %s is not a valid version %d snapshot\n", path, SNAPSHOT_VERSION);
+        unmapFile(&file);
+        return 0;
+    }
+
+    const SnapRoom* fileRooms = (const SnapRoom*)(file.data + roomsAt);
+    const SnapMonster* fileMonsters = (const SnapMonster*)(file.data + monstersAt);
+    const SnapItem* fileItems = (const SnapItem*)(file.data + itemsAt);
+    const int32_t* bagIndexes = (const int32_t*)(file.data + bagAt);
+    const int32_t* defeatedIndexes = (const int32_t*)(file.data + defeatedAt);
+    const unsigned char* bagShape = file.data + bagShapeAt;
+    const unsigned char* defeatedShape = file.data + defeatedShapeAt;
+    const char* strings = (const char*)(file.data + stringsAt);
+
+    int namesOk = 1;
+    int typesOk = 1;
+    for (uint32_t i = 0; i < header.monsterCount; i++) {
+        namesOk &= fileMonsters[i].name < header.stringBytes;
+        typesOk &= fileMonsters[i].type >= PHANTOM && fileMonsters[i].type <= COBRA;
+    }
+    for (uint32_t i = 0; i < header.itemCount; i++) {
+        namesOk &= fileItems[i].name < header.stringBytes;
+        typesOk &= fileItems[i].type >= ARMOR && fileItems[i].type <= SWORD;
+    }
+
+    if (!namesOk || !validateRefs(&header, fileRooms, bagIndexes, defeatedIndexes)) {
+        fprintf(stderr, "Snapshot %s has broken references\n", path);
+        unmapFile(&file);
+        return 0;
+    }
+    if (!typesOk) {
+        fprintf(stderr, "Snapshot %s has unknown monster or item types\n", path);
+        unmapFile(&file);
+        return 0;
+    }
+
+    //same room box limit as world files, in 64 bits
+    int64_t minX = 0, maxX = 0, minY = 0, maxY = 0;
+    for (uint32_t i = 0; i < header.roomCount; i++) {
+        if (fileRooms[i].x < minX) minX = fileRooms[i].x;
+        if (fileRooms[i].x > maxX) maxX = fileRooms[i].x;
+        if (fileRooms[i].y < minY) minY = fileRooms[i].y;
+        if (fileRooms[i].y > maxY) maxY = fileRooms[i].y;
+    }
+    if (maxX - minX >= WORLD_MAX_SPAN || maxY - minY >= WORLD_MAX_SPAN) {
+        fprintf(stderr, "Snapshot %s spans more than %d cells\n", path, WORLD_MAX_SPAN);
+        unmapFile(&file);
+        return 0;
+    }
+
+    //from here on the names point into the mapping, which the game now owns
+    g->worldFile = file;
+    if (g->arena == NULL)
+        g->arena = createArena(0);
+
+    Monster* monsters = (Monster*)arenaAlloc(g->arena, header.monsterCount * sizeof(Monster));
+    for (uint32_t i = 0; i < header.monsterCount; i++) {
+        monsters[i].name = (char*)internNameInPlace(&g->names, strings + fileMonsters[i].name);
+        monsters[i].sortKey = nameSortKey(monsters[i].name);
+        monsters[i].type = (MonsterType)fileMonsters[i].type;
+        monsters[i].hp = fileMonsters[i].hp;
+        monsters[i].maxHp = fileMonsters[i].maxHp;
+        monsters[i].attack = fileMonsters[i].attack;
+    }
+
+    Item* items = (Item*)arenaAlloc(g->arena, header.itemCount * sizeof(Item));
+    for (uint32_t i = 0; i < header.itemCount; i++) {
+        items[i].name = (char*)internNameInPlace(&g->names, strings + fileItems[i].name);
+        items[i].sortKey = nameSortKey(items[i].name);
+        items[i].type = (ItemType)fileItems[i].type;
+        items[i].value = fileItems[i].value;
+    }
+
+    Room* rooms = (Room*)arenaAlloc(g->arena, header.roomCount * sizeof(Room));
+    reserveRooms(g, (int)header.roomCount);
+    for (uint32_t i = 0; i < header.roomCount; i++) {
+        Room* room = &rooms[i];
+        room->x = fileRooms[i].x;
+        room->y = fileRooms[i].y;
+        room->visited = fileRooms[i].visited != 0;
+        room->monster = fileRooms[i].monster == -1 ? NULL : &monsters[fileRooms[i].monster];
+        room->item = fileRooms[i].item == -1 ? NULL : &items[fileRooms[i].item];
+
+        if (!registerRoom(g, room)) {
+            fprintf(stderr, "Snapshot %s has two rooms at (%d, %d)\n", path, room->x, room->y);
+            freeGame(g);
+            return 0;
+        }
+    }
+
+    if (!header.hasPlayer)
+        return 1;
+
+    Player* player = createPlayer(g);
+    player->hp = header.hp;
+    player->maxHp = header.maxHp;
+    player->baseAttack = header.baseAttack;
+    player->currentRoom = g->roomTable[header.currentRoom];
+    player->bag->balanced = header.bagBalanced != 0;
+    player->defeatedMonsters->balanced = header.defeatedBalanced != 0;
+    g->player = player;
+
+    //both trees come back with their exact shape unless either side is a B-tree
+    size_t scratchCount = header.bagCount > header.defeatedCount ? header.bagCount : header.defeatedCount;
+    void** scratch = (void**)malloc((scratchCount ? scratchCount : 1) * sizeof(void*));
+    if (scratch == NULL)
+        exit(1);
+
+    for (uint32_t i = 0; i < header.bagCount; i++)
+        scratch[i] = &items[bagIndexes[i]];
+    int ok = restoreTree(player->bag, scratch, bagShape, (int)header.bagCount, header.bagBalanced);
+
+    for (uint32_t i = 0; i < header.defeatedCount; i++)
+        scratch[i] = &monsters[defeatedIndexes[i]];
+    ok &= restoreTree(player->defeatedMonsters, scratch, defeatedShape, (int)header.defeatedCount,
+        header.defeatedBalanced);
+    free(scratch);
+
+    //the shapes came from the file unchecked, make sure they are still search trees
+    //(the bag never holds two equal items, the monster log can)
+    ok = ok && bstCheckLayout(player->bag, 1) && bstCheckLayout(player->defeatedMonsters, 0);
+
+    if (!ok) {
+        fprintf(stderr, "Snapshot %s has a broken tree layout\n", path);
+        freeGame(g);
+        return 0;
+    }
+
+    return 1;
+}
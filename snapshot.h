@@ -0,0 +1,31 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "game.h"
+
+/*
+ * Full game snapshot, all integers are 32 bit in native byte order.
+ * Sections follow the header in this order:
+ *   rooms     { x, y, visited, monster index or -1, item index or -1 }
+ *   monsters  { name offset, type, hp, maxHp, attack }
+ *   items     { name offset, type, value }
+ *   bag       item index of every bag node, in preorder
+ *   defeated  monster index of every defeated-log node, in preorder
+ *   bag shape, defeated shape   one BST_HAS_LEFT/BST_HAS_RIGHT byte per node
+ *   strings   NUL terminated names
+ * Storing the trees in preorder with their shape lets restore rebuild them
+ * node by node in O(n) without a single comparison. A B-tree backed tree
+ * (SNAPSHOT_TREE_BTREE in its header flag) is stored in key order with zero
+ * shape bytes instead and restored by insertion.
+ * Nothing in the file is trusted: rooms must fit in WORLD_MAX_SPAN, and a
+ * restored tree must be in key order, and AVL balanced if flagged so, or
+ * the snapshot is refused.
+ */
+#define SNAPSHOT_MAGIC "EX6S"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_TREE_BTREE 2   // bagBalanced/defeatedBalanced value of a B-tree
+
+int saveSnapshot(GameState* g, const char* path);
+int loadSnapshot(GameState* g, const char* path);
+
+#endif
@@ -0,0 +1,8 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdlib.h>
+#include "typedtrees.h"
+#include "prof.h"
+
+BST_TYPED_DEFINE(ItemTree, itemTree, Item, itemOrder)
+BST_TYPED_DEFINE(MonsterTree, monsterTree, Monster, monsterOrder)
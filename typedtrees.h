@@ -0,0 +1,15 @@
+#ifndef TYPEDTREES_H
+#define TYPEDTREES_H
+
+#include "bsttyped.h"
+#include "game.h"
+
+/*
+ * Bag and defeated-monster trees specialized for their element type: items
+ * and monsters are copied into the nodes and compared with itemOrder and
+ * monsterOrder inline. Names stay interned, so a copy never owns memory.
+ */
+BST_TYPED_DECLARE(ItemTree, itemTree, Item)
+BST_TYPED_DECLARE(MonsterTree, monsterTree, Monster)
+
+#endif
@@ -1,58 +1,128 @@
 #define _CRT_SECURE_NO_WARNINGS
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
 #include "utils.h"
+#include "prof.h"
 
-//gets string from user
+#define INPUT_BUFFER_SIZE (64 * 1024)
+#define STRING_MIN_CAPACITY 16
+
+/*
+ * Buffered stdin: input is pulled in big blocks and consumed from memory,
+ * instead of one scanf call per character.
+ */
+static char inputBuffer[INPUT_BUFFER_SIZE];
+static size_t inputPos = 0;
+static size_t inputLen = 0;
+static int inputEof = 0;
+
+//reads the next block of stdin, returns 0 once the input is exhausted
+static int refillInput(void) {
+    if (inputEof)
+        return 0;
+
+    //prompts must be visible before we block waiting for the user
+    fflush(stdout);
+
+    long count;
+    do {
+#ifndef _WIN32
+        count = (long)read(STDIN_FILENO, inputBuffer, INPUT_BUFFER_SIZE);
+#else
+        count = (long)_read(0, inputBuffer, INPUT_BUFFER_SIZE);
+#endif
+    } while (count < 0 && errno == EINTR);
+
+    if (count <= 0) {
+        inputEof = 1;
+        return 0;
+    }
+
+    inputPos = 0;
+    inputLen = (size_t)count;
+    return 1;
+}
+
+//returns the next input char without consuming it, or EOF
+static int peekInput(void) {
+    if (inputPos == inputLen && !refillInput())
+        return EOF;
+    return (unsigned char)inputBuffer[inputPos];
+}
+
+//same set of chars scanf skips for " " and %d
+static int isInputSpace(int ch) {
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\v' || ch == '\f' || ch == '\r';
+}
+
+static int skipInputSpaces(void) {
+    int ch = peekInput();
+    while (ch != EOF && isInputSpace(ch)) {
+        inputPos++;
+        ch = peekInput();
+    }
+    return ch;
+}
+
+//gets string from user: skips leading whitespace, then reads the rest of the line
 char* getString(const char* prompt) {
     if (prompt != NULL) {
         printf("%s", prompt);
     }
 
-    // Initial allocation for the first character (or null terminator placeholder)
-    char* str = (char*)malloc(sizeof(char));
+    // EOF before the first character means there is no string at all
+    if (skipInputSpaces() == EOF)
+        return NULL;
+
+    size_t capacity = STRING_MIN_CAPACITY;
+    size_t len = 0;
+    char* str = (char*)malloc(capacity);
     if (str == NULL) {
         exit(1);
     }
 
-    int len = 0;
-    char ch;
+    // Copy whole buffered chunks up to the end of the line
+    while (peekInput() != EOF) {
+        char* lineEnd = (char*)memchr(inputBuffer + inputPos, '\n', inputLen - inputPos);
+        size_t chunk = (lineEnd ? (size_t)(lineEnd - inputBuffer) : inputLen) - inputPos;
 
-    // Scan the first character
-    if (scanf(" %c", &ch) == 1) {
-        str[len] = ch;
-        len++;
-    }
-    else {
-        // If scanning failed (e.g. EOF), free memory and return NULL
-        free(str);
-        return NULL;
-    }
-
-    // Loop to read the rest of the line char by char
-    while (scanf("%c", &ch) == 1 && ch != '\n') {
-        // Reallocate exactly one byte more for the new character
-        char* temp = (char*)realloc(str, (len + 1) * sizeof(char));
-        if (temp == NULL) {
-            free(str);
-            exit(1);
+        // Grow geometrically, keeping room for the terminator
+        if (len + chunk + 1 > capacity) {
+            while (len + chunk + 1 > capacity)
+                capacity *= 2;
+            char* temp = (char*)realloc(str, capacity);
+            if (temp == NULL) {
+                free(str);
+                exit(1);
+            }
+            str = temp;
         }
-        str = temp;
 
-        str[len] = ch;
-        len++;
-    }
+        memcpy(str + len, inputBuffer + inputPos, chunk);
+        len += chunk;
+        inputPos += chunk;
 
-    // Reallocate one last time for the null terminator
-    char* temp = (char*)realloc(str, (len + 1) * sizeof(char));
-    if (temp == NULL) {
-        free(str);
-        exit(1);
+        if (lineEnd != NULL) {
+            inputPos++; // consume the newline
+            break;
+        }
     }
-    str = temp;
-    str[len] = '\0';
 
+    str[len] = '\0';
     return str;
 }
 
@@ -60,21 +130,122 @@ char* getString(const char* prompt) {
 int getIntInternal(const char* prompt, int* outVal) {
     if (prompt) printf("%s", prompt);
 
-    int temp;
-    // scanf returns 1 if it successfully read one integer
-    if (scanf("%d", &temp) != 1) {
+    // Same rules as scanf("%d"): leading whitespace, optional sign, digits
+    int ch = skipInputSpaces();
+    int negative = 0;
+    if (ch == '-' || ch == '+') {
+        negative = (ch == '-');
+        inputPos++;
+        ch = peekInput();
+    }
+
+    if (ch == EOF || ch < '0' || ch > '9')
         return 0; // EOF or Bad Input
+
+    unsigned int magnitude = 0;
+    while (ch != EOF && ch >= '0' && ch <= '9') {
+        magnitude = magnitude * 10u + (unsigned int)(ch - '0');
+        inputPos++;
+        ch = peekInput();
     }
 
-    // Clear buffer
-    int ch = getchar();
-    while (ch != '\n' && ch != EOF) {
-        ch = getchar();
+    // Drop the rest of the line
+    while (ch != EOF && ch != '\n') {
+        char* lineEnd = (char*)memchr(inputBuffer + inputPos, '\n', inputLen - inputPos);
+        inputPos = lineEnd ? (size_t)(lineEnd - inputBuffer) : inputLen;
+        ch = peekInput();
     }
 
     // Check if EOF happened during clear
     if (ch == EOF) return 0;
+    inputPos++;
 
-    *outVal = temp; // Set the value
+    *outVal = negative ? (int)(0u - magnitude) : (int)magnitude; // Set the value
     return 1; // Success
+}
+
+//wall clock in nanoseconds, used for timing frames and benchmarks
+long long nowNanos(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * Maps a whole file read-only. Returns 1 on success, 0 if the file cannot
+ * be opened or read. Platforms without mmap get a heap copy instead.
+ */
+int mapFile(const char* path, MappedFile* file) {
+    file->data = NULL;
+    file->size = 0;
+    file->isMapped = 0;
+
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return 0;
+    }
+
+    file->size = (size_t)st.st_size;
+    if (file->size > 0) {
+        void* data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return 0;
+        }
+        file->data = (const unsigned char*)data;
+        file->isMapped = 1;
+    }
+
+    //the mapping stays valid after the descriptor is closed
+    close(fd);
+    return 1;
+#else
+    FILE* in = fopen(path, "rb");
+    if (in == NULL)
+        return 0;
+
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(in);
+        return 0;
+    }
+
+    unsigned char* data = (unsigned char*)malloc(size > 0 ? (size_t)size : 1);
+    if (data == NULL)
+        exit(1);
+    if (fread(data, 1, (size_t)size, in) != (size_t)size) {
+        free(data);
+        fclose(in);
+        return 0;
+    }
+
+    fclose(in);
+    file->data = data;
+    file->size = (size_t)size;
+    return 1;
+#endif
+}
+
+//releases a file obtained from mapFile
+void unmapFile(MappedFile* file) {
+    if (file->data != NULL) {
+#ifndef _WIN32
+        if (file->isMapped)
+            munmap((void*)file->data, file->size);
+        else
+#endif
+            free((void*)file->data);
+    }
+
+    file->data = NULL;
+    file->size = 0;
+    file->isMapped = 0;
 }
\ No newline at end of file
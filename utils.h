@@ -1,7 +1,19 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <stddef.h>
+
+//read-only view of a whole file, memory mapped where the platform allows it
+typedef struct {
+    const unsigned char* data;
+    size_t size;
+    int isMapped;   // 0 when the fallback read the file into the heap
+} MappedFile;
+
 int getIntInternal(const char* prompt, int* outVal);
 char* getString(const char* prompt);
+long long nowNanos(void);
+int mapFile(const char* path, MappedFile* file);
+void unmapFile(MappedFile* file);
 
 #endif
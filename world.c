@@ -0,0 +1,256 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "world.h"
+#include "prof.h"
+
+#define WORLD_WRITE_BUFFER (1 << 20)
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t roomCount;
+    uint32_t monsterCount;
+    uint32_t itemCount;
+    uint32_t stringBytes;
+} WorldHeader;
+
+typedef struct {
+    int32_t x, y;
+    int32_t monster;
+    int32_t item;
+} WorldRoom;
+
+typedef struct {
+    uint32_t name;
+    int32_t type;
+    int32_t hp;
+    int32_t attack;
+} WorldMonster;
+
+typedef struct {
+    uint32_t name;
+    int32_t type;
+    int32_t value;
+} WorldItem;
+
+//checks that every room references an existing monster/item at most once
+static int validateRefs(const WorldRoom* rooms, uint32_t roomCount,
+                        uint32_t monsterCount, uint32_t itemCount) {
+    unsigned char* used = (unsigned char*)calloc((size_t)monsterCount + itemCount + 1, 1);
+    if (used == NULL)
+        exit(1);
+
+    int ok = 1;
+    for (uint32_t i = 0; i < roomCount && ok; i++) {
+        int32_t m = rooms[i].monster;
+        int32_t it = rooms[i].item;
+
+        if (m != -1 && (m < 0 || (uint32_t)m >= monsterCount || used[m]++))
+            ok = 0;
+        if (it != -1 && (it < 0 || (uint32_t)it >= itemCount || used[monsterCount + it]++))
+            ok = 0;
+    }
+
+    free(used);
+    return ok;
+}
+
+/*
+ * Loads a whole world file into an empty game.
+ * The file is mapped and names are used in place, so the game switches to
+ * arena mode and keeps the mapping until freeGame.
+ * Returns 1 on success, 0 (with a message) if the file is invalid.
+ */
+int loadWorld(GameState* g, const char* path) {
+    if (g->roomCount != 0 || g->worldFile.data != NULL) {
+        fprintf(stderr, "World can only be loaded into an empty game\n");
+        return 0;
+    }
+
+    MappedFile file;
+    if (!mapFile(path, &file)) {
+        fprintf(stderr, "Cannot read world file %s\n", path);
+        return 0;
+    }
+
+    WorldHeader header;
+    if (file.size < sizeof(WorldHeader)) {
+        fprintf(stderr, "World file %s is truncated\n", path);
+        unmapFile(&file);
+        return 0;
+    }
+    memcpy(&header, file.data, sizeof(WorldHeader));
+
+    uint64_t roomsAt = sizeof(WorldHeader);
+    uint64_t monstersAt = roomsAt + (uint64_t)header.roomCount * sizeof(WorldRoom);
+    uint64_t itemsAt = monstersAt + (uint64_t)header.monsterCount * sizeof(WorldMonster);
+    uint64_t stringsAt = itemsAt + (uint64_t)header.itemCount * sizeof(WorldItem);
+    uint64_t expectedSize = stringsAt + header.stringBytes;
+
+    if (memcmp(header.magic, WORLD_MAGIC, 4) != 0 || header.version != WORLD_VERSION
+        || header.roomCount == 0 || header.roomCount > INT32_MAX
+        || expectedSize != file.size
+        || (header.stringBytes > 0 && file.data[file.size - 1] != '\0')) {
+        fprintf(stderr, "World file %s is not a valid version %d world\n", path, WORLD_VERSION);
+        unmapFile(&file);
+        return 0;
+    }
+
+    const WorldRoom* fileRooms = (const WorldRoom*)(file.data + roomsAt);
+    const WorldMonster* fileMonsters = (const WorldMonster*)(file.data + monstersAt);
+    const WorldItem* fileItems = (const WorldItem*)(file.data + itemsAt);
+    const char* strings = (const char*)(file.data + stringsAt);
+
+    int namesOk = 1;
+    int typesOk = 1;
+    for (uint32_t i = 0; i < header.monsterCount; i++) {
+        namesOk &= fileMonsters[i].name < header.stringBytes;
+        typesOk &= fileMonsters[i].type >= PHANTOM && fileMonsters[i].type <= COBRA;
+    }
+    for (uint32_t i = 0; i < header.itemCount; i++) {
+        namesOk &= fileItems[i].name < header.stringBytes;
+        typesOk &= fileItems[i].type >= ARMOR && fileItems[i].type <= SWORD;
+    }
+
+    if (!namesOk || !validateRefs(fileRooms, header.roomCount, header.monsterCount, header.itemCount)) {
+        fprintf(stderr, "World file %s has broken references\n", path);
+        unmapFile(&file);
+        return 0;
+    }
+    //the type printers have no name for anything else
+    if (!typesOk) {
+        fprintf(stderr, "World file %s has unknown monster or item types\n", path);
+        unmapFile(&file);
+        return 0;
+    }
+
+    //64 bit bounds, a span across the whole int range must not overflow
+    int64_t minX = 0, maxX = 0, minY = 0, maxY = 0;
+    for (uint32_t i = 0; i < header.roomCount; i++) {
+        if (fileRooms[i].x < minX) minX = fileRooms[i].x;
+        if (fileRooms[i].x > maxX) maxX = fileRooms[i].x;
+        if (fileRooms[i].y < minY) minY = fileRooms[i].y;
+        if (fileRooms[i].y > maxY) maxY = fileRooms[i].y;
+    }
+    if (maxX - minX >= WORLD_MAX_SPAN || maxY - minY >= WORLD_MAX_SPAN) {
+        fprintf(stderr, "World file %s spans more than %d cells\n", path, WORLD_MAX_SPAN);
+        unmapFile(&file);
+        return 0;
+    }
+
+    //from here on the names point into the mapping, which the game now owns
+    g->worldFile = file;
+    if (g->arena == NULL)
+        g->arena = createArena(0);
+
+    Monster* monsters = (Monster*)arenaAlloc(g->arena, header.monsterCount * sizeof(Monster));
+    for (uint32_t i = 0; i < header.monsterCount; i++) {
+        monsters[i].name = (char*)internNameInPlace(&g->names, strings + fileMonsters[i].name);
+        monsters[i].sortKey = nameSortKey(monsters[i].name);
+        monsters[i].type = (MonsterType)fileMonsters[i].type;
+        monsters[i].hp = fileMonsters[i].hp;
+        monsters[i].maxHp = fileMonsters[i].hp;
+        monsters[i].attack = fileMonsters[i].attack;
+    }
+
+    Item* items = (Item*)arenaAlloc(g->arena, header.itemCount * sizeof(Item));
+    for (uint32_t i = 0; i < header.itemCount; i++) {
+        items[i].name = (char*)internNameInPlace(&g->names, strings + fileItems[i].name);
+        items[i].sortKey = nameSortKey(items[i].name);
+        items[i].type = (ItemType)fileItems[i].type;
+        items[i].value = fileItems[i].value;
+    }
+
+    Room* rooms = (Room*)arenaAlloc(g->arena, header.roomCount * sizeof(Room));
+    reserveRooms(g, (int)header.roomCount);
+    for (uint32_t i = 0; i < header.roomCount; i++) {
+        Room* room = &rooms[i];
+        room->x = fileRooms[i].x;
+        room->y = fileRooms[i].y;
+        room->visited = 0;
+        room->monster = fileRooms[i].monster == -1 ? NULL : &monsters[fileRooms[i].monster];
+        room->item = fileRooms[i].item == -1 ? NULL : &items[fileRooms[i].item];
+
+        if (!registerRoom(g, room)) {
+            fprintf(stderr, "World file %s has two rooms at (%d, %d)\n", path, room->x, room->y);
+            freeGame(g);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Writes the rooms of a game, with their current monsters and items,
+ * in the format loadWorld reads. Returns 1 on success, 0 on I/O failure.
+ */
+int saveWorld(GameState* g, const char* path) {
+    FILE* out = fopen(path, "wb");
+    if (out == NULL)
+        return 0;
+    setvbuf(out, NULL, _IOFBF, WORLD_WRITE_BUFFER);
+
+    WorldHeader header;
+    memcpy(header.magic, WORLD_MAGIC, 4);
+    header.version = WORLD_VERSION;
+    header.roomCount = (uint32_t)g->roomCount;
+    header.monsterCount = 0;
+    header.itemCount = 0;
+    header.stringBytes = 0;
+
+    for (int i = 0; i < g->roomCount; i++) {
+        Room* room = g->roomTable[i];
+        if (room->monster) {
+            header.monsterCount++;
+            header.stringBytes += (uint32_t)strlen(room->monster->name) + 1;
+        }
+        if (room->item) {
+            header.itemCount++;
+            header.stringBytes += (uint32_t)strlen(room->item->name) + 1;
+        }
+    }
+    fwrite(&header, sizeof(header), 1, out);
+
+    int32_t monsterIndex = 0, itemIndex = 0;
+    for (int i = 0; i < g->roomCount; i++) {
+        Room* room = g->roomTable[i];
+        WorldRoom record = { room->x, room->y,
+            room->monster ? monsterIndex++ : -1,
+            room->item ? itemIndex++ : -1 };
+        fwrite(&record, sizeof(record), 1, out);
+    }
+
+    //names are laid out monsters first, then items, both in room order
+    uint32_t nameAt = 0;
+    for (int i = 0; i < g->roomCount; i++) {
+        Monster* m = g->roomTable[i]->monster;
+        if (m == NULL)
+            continue;
+        WorldMonster record = { nameAt, (int32_t)m->type, m->hp, m->attack };
+        fwrite(&record, sizeof(record), 1, out);
+        nameAt += (uint32_t)strlen(m->name) + 1;
+    }
+    for (int i = 0; i < g->roomCount; i++) {
+        Item* it = g->roomTable[i]->item;
+        if (it == NULL)
+            continue;
+        WorldItem record = { nameAt, (int32_t)it->type, it->value };
+        fwrite(&record, sizeof(record), 1, out);
+        nameAt += (uint32_t)strlen(it->name) + 1;
+    }
+
+    for (int i = 0; i < g->roomCount; i++)
+        if (g->roomTable[i]->monster)
+            fwrite(g->roomTable[i]->monster->name, 1, strlen(g->roomTable[i]->monster->name) + 1, out);
+    for (int i = 0; i < g->roomCount; i++)
+        if (g->roomTable[i]->item)
+            fwrite(g->roomTable[i]->item->name, 1, strlen(g->roomTable[i]->item->name) + 1, out);
+
+    int ok = !ferror(out);
+    ok &= fclose(out) == 0;
+    return ok;
+}
@@ -0,0 +1,24 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include "game.h"
+
+/*
+ * Compact world file, all integers are 32 bit in native byte order:
+ *   header   "EX6W", version, roomCount, monsterCount, itemCount, stringBytes
+ *   rooms    roomCount    x { x, y, monster index or -1, item index or -1 }
+ *   monsters monsterCount x { name offset, type, hp, attack }
+ *   items    itemCount    x { name offset, type, value }
+ *   strings  stringBytes of NUL terminated names
+ * Rooms get ids in file order, so the first room is the starting room.
+ * The map is drawn over the box holding every room and (0, 0); a file
+ * whose box is wider or higher than WORLD_MAX_SPAN cells is refused.
+ */
+#define WORLD_MAGIC "EX6W"
+#define WORLD_VERSION 1
+#define WORLD_MAX_SPAN (1 << 16)
+
+int loadWorld(GameState* g, const char* path);
+int saveWorld(GameState* g, const char* path);
+
+#endif